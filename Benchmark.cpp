@@ -0,0 +1,445 @@
+//shaked1mi@gmail.com
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include "MyContainer.hpp"
+
+using namespace customContainer;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Runs work once and returns how long it took in milliseconds.
+     */
+    template<typename Work>
+    double time_ms(Work work)
+    {
+        auto start = Clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void print_row(const std::string &name, double ms)
+    {
+        std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(10)
+                  << std::fixed << std::setprecision(2) << ms << " ms\n";
+    }
+
+    /**
+     * Times filling a container with the given values, walking it in insertion,
+     * ascending and reverse order, and destroying it. The sums are printed so the
+     * loops can't be optimized away.
+     */
+    template<typename Container, typename Value>
+    void bench_storage(const std::string &label, const std::vector<Value> &values)
+    {
+        std::cout << label << "\n";
+        long long checksum = 0;
+        std::optional<Container> holder;
+        holder.emplace();
+        {
+            Container &container = *holder;
+            print_row("add", time_ms([&] {
+                for (const Value &value : values)
+                    container.add(value);
+            }));
+            print_row("insertion order", time_ms([&] {
+                for (auto it = container.begin_order(); it != container.end_order(); ++it)
+                    checksum += *it;
+            }));
+            print_row("ascending order", time_ms([&] {
+                for (const Value &value : container.ascending())
+                    checksum += value;
+            }));
+            print_row("reverse order", time_ms([&] {
+                for (const Value &value : container.reverse())
+                    checksum += value;
+            }));
+        }
+        print_row("destroy", time_ms([&] { holder.reset(); }));
+        std::cout << "  (checksum " << checksum << ")\n";
+    }
+
+    /**
+     * Times a remove/add churn: every round removes a slice of the values and adds
+     * them back, which is where recycling nodes pays off. The value index finds the nodes
+     * to remove, so the loop is not a walk over the list and the allocator shows.
+     */
+    template<typename Container>
+    void bench_churn(const std::string &label, const std::vector<int> &values)
+    {
+        std::cout << label << "\n";
+        Container container;
+        const std::size_t slice = std::min<std::size_t>(values.size(), 100000);
+        for (int value : values)
+            container.add(value);
+        container.enable_index();
+        std::size_t removed = 0;
+        print_row(std::to_string(slice) + " remove/add churn", time_ms([&] {
+            for (std::size_t i = 0; i < slice; ++i)
+            {
+                removed += container.try_remove(values[i]);
+                container.add(values[i]);
+            }
+        }));
+        std::cout << "  (removed " << removed << ", size " << container.size() << ")\n";
+    }
+
+    /**
+     * Reads every element of an order, so all of it gets sorted.
+     * @return the number of elements
+     */
+    template<typename View>
+    std::size_t walk(View view)
+    {
+        std::size_t count = 0;
+        for (const auto &element : view)
+            count += &element != nullptr;
+        return count;
+    }
+
+    /**
+     * Times building the ascending order of a container, which picks its sort from the
+     * element type, against a plain std::sort of element pointers with operator<, and
+     * reading only the first 10 ascending or side-cross elements, which sorts no more
+     * than it needs.
+     */
+    template<typename Value>
+    void bench_sort(const std::string &label, const std::vector<Value> &values)
+    {
+        std::cout << label << "\n";
+        MyContainer<Value> container(values.begin(), values.end());
+        MyContainer<Value> top(container);
+        MyContainer<Value> cross(container);
+        std::vector<Value *> pointers;
+        for (auto it = container.begin_order(); it != container.end_order(); ++it)
+            pointers.push_back(&*it);
+
+        print_row("std::sort over pointers", time_ms([&] {
+            std::sort(pointers.begin(), pointers.end(), [](Value *a, Value *b) { return *a < *b; });
+        }));
+        std::size_t checksum = 0;
+        print_row("ascending order", time_ms([&] { checksum += walk(container.ascending()); }));
+        double smallest = 0;
+        print_row("first 10 ascending", time_ms([&] {
+            auto it = top.begin_ascending_order();
+            for (std::size_t i = 0; i < 10 && i < values.size(); ++i, ++it)
+                smallest += *it;
+        }));
+        double extremes = 0;
+        print_row("first 10 side-cross", time_ms([&] {
+            auto it = cross.begin_side_cross_order();
+            for (std::size_t i = 0; i < 10 && i < values.size(); ++i, ++it)
+                extremes += *it;
+        }));
+        std::cout << "  (walked " << checksum << ", sums " << smallest << " and " << extremes << ", smallest "
+                  << *pointers.front() << ")\n";
+    }
+
+    /**
+     * Like bench_sort(), but over many small containers of size elements each, the sizes
+     * where the sorted orders use the SIMD kernel when the CPU has AVX2.
+     */
+    template<typename Value>
+    void bench_small_sorts(const std::string &label, const std::vector<Value> &values, std::size_t size)
+    {
+        std::cout << label << "\n";
+        std::vector<MyContainer<Value>> containers;
+        std::vector<std::vector<Value *>> pointers;
+        for (std::size_t start = 0; start + size <= values.size(); start += size)
+        {
+            containers.emplace_back(values.begin() + start, values.begin() + start + size);
+            pointers.emplace_back();
+            for (auto it = containers.back().begin_order(); it != containers.back().end_order(); ++it)
+                pointers.back().push_back(&*it);
+        }
+
+        print_row("std::sort over pointers", time_ms([&] {
+            for (std::vector<Value *> &batch : pointers)
+                std::sort(batch.begin(), batch.end(), [](Value *a, Value *b) { return *a < *b; });
+        }));
+        double checksum = 0;
+        print_row("ascending order", time_ms([&] {
+            for (MyContainer<Value> &container : containers)
+                checksum += walk(container.ascending());
+        }));
+        std::cout << "  (" << containers.size() << " containers, checksum " << checksum << ")\n";
+    }
+
+    /**
+     * Times building the ascending order of strings, sorted on their 8-byte prefixes
+     * first, against a plain std::sort of element pointers with operator<.
+     */
+    void bench_strings(const std::string &label, const std::vector<std::string> &words)
+    {
+        std::cout << label << "\n";
+        MyContainer<std::string> container(words.begin(), words.end());
+        std::vector<std::string *> pointers;
+        for (auto it = container.begin_order(); it != container.end_order(); ++it)
+            pointers.push_back(&*it);
+
+        print_row("std::sort over pointers", time_ms([&] {
+            std::sort(pointers.begin(), pointers.end(), [](std::string *a, std::string *b) { return *a < *b; });
+        }));
+        std::size_t checksum = 0;
+        print_row("ascending order", time_ms([&] { checksum += walk(container.ascending()); }));
+        std::cout << "  (walked " << checksum << ", smallest " << pointers.front()->size() << " bytes)\n";
+    }
+
+    /// A record sorted by a key computed from its fields
+    struct Record
+    {
+        int id;
+        std::string name;
+    };
+
+    /**
+     * Times sorting records by a computed string key (the name reversed) with std::sort
+     * computing the key on every comparison, against the container's projection, which
+     * computes it once per element.
+     */
+    void bench_projection(const std::vector<int> &values)
+    {
+        std::cout << "sorting records by a computed key\n";
+        const auto reversedName = [](const Record &record) { return std::string(record.name.rbegin(), record.name.rend()); };
+        MyContainer<Record, LinkedStorage, std::allocator<Record>, std::less<>, decltype(reversedName)> records(
+            std::less<>(), reversedName);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            records.add(Record{static_cast<int>(i), std::to_string(values[i])});
+        std::vector<const Record *> pointers;
+        for (auto it = records.begin_order(); it != records.end_order(); ++it)
+            pointers.push_back(&*it);
+
+        print_row("key on every comparison", time_ms([&] {
+            std::sort(pointers.begin(), pointers.end(),
+                      [&](const Record *a, const Record *b) { return reversedName(*a) < reversedName(*b); });
+        }));
+        long long checksum = 0;
+        print_row("ascending order", time_ms([&] { checksum += static_cast<long long>(walk(records.ascending())); }));
+        std::cout << "  (walked " << checksum << ", first " << pointers.front()->id << ")\n";
+    }
+
+    /**
+     * Times building the ascending order of the same elements with 1, 2, 4, ... threads up
+     * to the hardware's thread count (at least 2, so the parallel path always runs).
+     */
+    void bench_parallel_sort(const std::vector<int> &values)
+    {
+        const unsigned most = std::max(2u, ThreadPool::hardware_threads());
+        std::cout << "parallel sort of MyContainer<int>, " << ThreadPool::hardware_threads() << " hardware threads\n";
+        const MyContainer<int> original(values.begin(), values.end());
+        long long checksum = 0;
+        for (unsigned threads = 1; threads <= most; threads = threads * 2 > most && threads < most ? most : threads * 2)
+        {
+            MyContainer<int> container(original);
+            container.set_sort_options({0, threads});
+            print_row(std::to_string(threads) + (threads == 1 ? " thread" : " threads"),
+                      time_ms([&] { checksum += static_cast<long long>(walk(container.ascending())); }));
+        }
+        std::cout << "  (checksum " << checksum << ")\n";
+    }
+
+    /**
+     * Times lookups of missing values and removals of present ones, with and without the
+     * value index. Building the index is timed separately.
+     */
+    template<typename Container>
+    void bench_index(const std::string &label, const std::vector<int> &values, bool indexed)
+    {
+        std::cout << label << (indexed ? ", indexed" : "") << "\n";
+        Container container(values.begin(), values.end());
+        if (indexed)
+            print_row("enable_index()", time_ms([&] { container.enable_index(); }));
+
+        const std::size_t lookups = std::min<std::size_t>(values.size(), indexed ? 100000 : 64);
+        std::size_t found = 0;
+        print_row(std::to_string(lookups) + " missing contains()", time_ms([&] {
+            for (std::size_t i = 0; i < lookups; ++i)
+                found += container.contains(static_cast<int>(i) * 2 + 1) ? 1 : 0;
+        }));
+        const std::size_t removals = std::min<std::size_t>(values.size(), 64);
+        print_row(std::to_string(removals) + " remove()", time_ms([&] {
+            for (std::size_t i = 0; i < removals; ++i)
+                if (container.contains(values[i]))
+                    container.remove(values[i]);
+        }));
+        std::cout << "  (found " << found << ", left " << container.size() << ")\n";
+    }
+
+    /**
+     * Times removing the same 64 values with one remove() per value and with a single
+     * remove_all() call.
+     */
+    template<typename Container>
+    void bench_batch_removal(const std::string &label, const std::vector<int> &values)
+    {
+        std::cout << label << "\n";
+        const std::vector<int> unwanted(values.begin(), values.begin() + std::min<std::size_t>(values.size(), 64));
+        Container one(values.begin(), values.end());
+        Container batch(one);
+        print_row("remove() per value", time_ms([&] {
+            for (int value : unwanted)
+                if (one.contains(value))
+                    one.remove(value);
+        }));
+        std::size_t removed = 0;
+        print_row("remove_all()", time_ms([&] { removed = batch.remove_all(unwanted); }));
+        std::cout << "  (left " << one.size() << " and " << batch.size() << ", removed " << removed << ")\n";
+    }
+
+    /**
+     * Times three ways of filling a container with the same batch: one add() per value,
+     * reserve() followed by add(), and the iterator-pair constructor, each including the
+     * destruction of the container.
+     */
+    template<typename Container>
+    void bench_bulk(const std::string &label, const std::vector<int> &values)
+    {
+        std::cout << label << "\n";
+        std::size_t checksum = 0;
+        print_row("repeated add()", time_ms([&] {
+            Container container;
+            for (int value : values)
+                container.add(value);
+            checksum += container.size();
+        }));
+        print_row("reserve() + add()", time_ms([&] {
+            Container container;
+            container.reserve(values.size());
+            for (int value : values)
+                container.add(value);
+            checksum += container.size();
+        }));
+        print_row("range constructor", time_ms([&] {
+            Container container(values.begin(), values.end());
+            checksum += container.size();
+        }));
+        std::cout << "  (checksum " << checksum << ")\n";
+    }
+
+    /**
+     * Times request-style cycles: build a container from a batch, iterate it in ascending
+     * order and destroy it. With Arena set, every cycle runs on a monotonic arena over
+     * one reused buffer, which is released in one shot at the end of the cycle.
+     */
+    template<bool Arena>
+    void bench_cycles(const std::string &label, const std::vector<int> &values, std::size_t cycles)
+    {
+        std::vector<unsigned char> buffer(values.size() * 64);
+        long long checksum = 0;
+        double ms = time_ms([&] {
+            for (std::size_t cycle = 0; cycle < cycles; ++cycle)
+            {
+                if constexpr (Arena)
+                {
+                    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+                    customContainer::pmr::MyContainer<int> container(&arena);
+                    for (int value : values)
+                        container.add(value);
+                    for (int value : container.ascending())
+                        checksum += value;
+                }
+                else
+                {
+                    MyContainer<int> container;
+                    for (int value : values)
+                        container.add(value);
+                    for (int value : container.ascending())
+                        checksum += value;
+                }
+            }
+        });
+        std::cout << label << "\n";
+        print_row("add/iterate/destroy cycles", ms);
+        std::cout << "  (checksum " << checksum << ")\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937 rng(42);
+    std::vector<int> values(n);
+    for (int &value : values)
+        value = static_cast<int>(rng());
+    std::vector<char> letters(n);
+    for (char &letter : letters)
+        letter = static_cast<char>('a' + rng() % 26);
+    std::vector<short> shorts(n);
+    for (short &value : shorts)
+        value = static_cast<short>(rng());
+
+    std::cout << "Elements: " << n << "\n\n";
+    bench_storage<MyContainer<int, LinkedStorage>>("MyContainer<int, LinkedStorage>", values);
+    bench_storage<MyContainer<int, ContiguousStorage>>("MyContainer<int, ContiguousStorage>", values);
+    bench_storage<MyContainer<int, UnrolledStorage>>("MyContainer<int, UnrolledStorage>", values);
+    bench_storage<MyContainer<char, LinkedStorage>>("MyContainer<char, LinkedStorage>", letters);
+    bench_storage<MyContainer<char, UnrolledStorage>>("MyContainer<char, UnrolledStorage>", letters);
+    bench_storage<MyContainer<int, LinkedStorage, PoolAllocator<int>>>(
+        "MyContainer<int, LinkedStorage, PoolAllocator>", values);
+
+    std::cout << "\n";
+    bench_churn<MyContainer<int, LinkedStorage>>("MyContainer<int, LinkedStorage>", values);
+    bench_churn<MyContainer<int, LinkedStorage, PoolAllocator<int>>>(
+        "MyContainer<int, LinkedStorage, PoolAllocator>", values);
+
+    std::vector<double> reals(n);
+    for (double &real : reals)
+        real = std::ldexp(static_cast<double>(static_cast<int>(rng())), -20);
+    std::cout << "\n";
+    bench_sort<int>("sorting MyContainer<int>", values);
+    bench_sort<double>("sorting MyContainer<double>", reals);
+    bench_sort<char>("sorting MyContainer<char>", letters);
+    bench_sort<short>("sorting MyContainer<short>", shorts);
+    bench_sort<long double>("sorting MyContainer<long double>", std::vector<long double>(reals.begin(), reals.end()));
+    bench_small_sorts<int>("sorting MyContainer<int> of 1000", values, 1000);
+    bench_small_sorts<double>("sorting MyContainer<double> of 1000", reals, 1000);
+    bench_parallel_sort(values);
+    std::vector<std::string> words, paths;
+    for (std::size_t i = 0; i < std::min<std::size_t>(n, 500000); ++i)
+    {
+        words.push_back(std::to_string(static_cast<unsigned>(values[i])));
+        paths.push_back("/usr/share/doc/" + words.back());
+    }
+    bench_strings("sorting MyContainer<std::string>", words);
+    bench_strings("sorting MyContainer<std::string>, common prefix", paths);
+    bench_projection(std::vector<int>(values.begin(), values.begin() + std::min<std::size_t>(n, 200000)));
+
+    // Even values only, so the odd lookups all miss
+    std::vector<int> evens(values);
+    for (int &value : evens)
+        value &= ~1;
+    std::cout << "\n";
+    bench_index<MyContainer<int, LinkedStorage>>("MyContainer<int, LinkedStorage>", evens, false);
+    bench_index<MyContainer<int, LinkedStorage>>("MyContainer<int, LinkedStorage>", evens, true);
+    bench_index<MyContainer<int, UnrolledStorage>>("MyContainer<int, UnrolledStorage>", evens, true);
+
+    std::cout << "\n";
+    bench_batch_removal<MyContainer<int, LinkedStorage>>("MyContainer<int, LinkedStorage>", values);
+    bench_batch_removal<MyContainer<int, UnrolledStorage>>("MyContainer<int, UnrolledStorage>", values);
+
+    std::cout << "\n";
+    bench_bulk<MyContainer<int, LinkedStorage>>("bulk fill, MyContainer<int, LinkedStorage>", values);
+    bench_bulk<MyContainer<int, UnrolledStorage>>("bulk fill, MyContainer<int, UnrolledStorage>", values);
+    bench_bulk<MyContainer<int, ContiguousStorage>>("bulk fill, MyContainer<int, ContiguousStorage>", values);
+
+    std::cout << "\n";
+    const std::size_t batch = std::min<std::size_t>(n, 100000);
+    const std::vector<int> requestValues(values.begin(), values.begin() + batch);
+    bench_cycles<false>("20 cycles of " + std::to_string(batch) + ", std::allocator", requestValues, 20);
+    bench_cycles<true>("20 cycles of " + std::to_string(batch) + ", pmr monotonic arena", requestValues, 20);
+
+    return 0;
+}
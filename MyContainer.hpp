@@ -1,65 +1,384 @@
 // shaked1mi@gmail.com
 
 #pragma once
+#include "Sorting.hpp"
+#include "Storage.hpp"
+#include "ValueIndex.hpp"
 #include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <ostream>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace customContainer
     {
-    template<typename T = int>
+    /**
+     * A container that can be iterated in several orders.
+     * @tparam T - the element type
+     * @tparam Storage - how the elements are kept in memory, LinkedStorage (a node per element),
+     * ContiguousStorage (one buffer) or UnrolledStorage (chunks). All keep the same API and
+     * all iteration orders.
+     * @tparam Allocator - a standard allocator for T, the storage rebinds it to its node or
+     * chunk type. PoolAllocator recycles nodes and frees them in bulk.
+     * @tparam Compare - orders the keys for the ascending, descending and side-cross orders
+     * @tparam Projection - gives the key of an element, e.g. one field of a struct. A key the
+     * projection returns by value is computed once per element and sort.
+     */
+    template<typename T = int, template<typename, typename> class Storage = LinkedStorage,
+             typename Allocator = std::allocator<T>, typename Compare = std::less<>,
+             typename Projection = Identity>
     class MyContainer
     {
     private:
-        struct Node
-        {
-            T data;
-            Node *next;
+        using Elements = Storage<T, Allocator>;
+        using Cursor = typename Elements::Cursor;
+
+        /// An ordering of the elements, the input of the sorted order. The lists are
+        /// allocated with the container's allocator, like the elements.
+        using ListAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<T *>;
+        using ElementList = std::vector<T *, ListAllocator>;
+
+        /// The sorted order shared by the ascending, descending and side-cross orders,
+        /// sorted as far as the iterators have read it
+        using SortedElements = LazySort<T, ListAllocator, Compare, Projection>;
+        using SharedSorted = std::shared_ptr<SortedElements>;
+
+        using Index = ValueIndex<T, Elements, Allocator>;
+
+        Elements storage;
+        std::unique_ptr<Index> index;     /// Optional value index, see enable_index()
 
-            explicit Node(const T &data) : data(data), next(nullptr)
+        std::size_t generation;           /// Bumped by every add() and remove() that changes the container
+        SharedSorted sortedCache;         /// Elements in ascending order, shared by all sorted orders
+        std::size_t sortedGeneration;     /// The generation sortedCache was built for
+        SortOptions sortOptions;          /// When the sort is split between threads
+        Compare compare;                  /// Orders the keys of the sorted orders
+        Projection projection;            /// Gives the key of an element
+
+        /**
+         * Returns the elements in ascending order. The permutation is cached and only
+         * rebuilt when the container was changed since the last call, so the ascending,
+         * descending and side-cross orders all share a single sort. It is lazy: only the
+         * positions the iterators read get sorted, see LazySort.
+         * A new permutation is built on every rebuild, so iterators that still hold the old
+         * one are never changed under their feet. Iterators that hold it (a begin() and the
+         * iterators derived from it) can be read from several threads at once, but fetching
+         * it changes the container and needs the same care as add().
+         * @return the cached ascending permutation of the elements
+         */
+        SharedSorted sorted_elements()
+        {
+            if (sortedGeneration != generation)
             {
+                ListAllocator allocator(storage.get_allocator());
+                sortedCache = std::allocate_shared<SortedElements>(allocator, insertion_elements(), sortOptions,
+                                                                   compare, projection);
+                sortedGeneration = generation;
             }
-        };
+            return sortedCache;
+        }
 
-        Node *head;
+        /**
+         * Collects pointers to the elements in insertion order.
+         * @return a list with every element from first to last inserted
+         */
+        ElementList insertion_elements()
+        {
+            ElementList elements{ListAllocator(storage.get_allocator())};
+            elements.reserve(storage.size());
+            for (Cursor pos = storage.begin(); pos != storage.end(); ++pos)
+                elements.push_back(&*pos);
+            return elements;
+        }
+
+        /**
+         * Reports a misuse of the throwing API: throws out_of_range, or aborts when the code
+         * is built without exceptions (-fno-exceptions), where try_remove() is the way to go.
+         * @param what - the error message
+         */
+        [[noreturn]] static void fail(const char *what)
+        {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+            throw std::out_of_range(what);
+#else
+            (void)what;
+            std::abort();
+#endif
+        }
+
+        /**
+         * Tells the index (if any) about the element that was just added last.
+         * @param element - the new element
+         */
+        void index_added(const T &element)
+        {
+            if (!index)
+                return;
+
+            if constexpr (Index::TracksPositions)
+                index->added(element, storage.last());
+            else
+                index->added(element, Cursor());
+        }
+
+        /**
+         * Removes every element equal to data using the index: a value that isn't there is
+         * rejected without touching the storage, and when the index knows the positions only
+         * the matching elements are visited.
+         * @return how many elements were removed
+         */
+        std::size_t remove_indexed(const T &data)
+        {
+            if (index->count(data) == 0)
+                return 0;
+
+            typename Index::Positions positions = index->take(data);
+            if constexpr (Index::TracksPositions)
+            {
+                for (Cursor position : positions)
+                    storage.erase(position);
+                return positions.size();
+            }
+            else
+            {
+                return storage.erase_if([&data](const T &element) { return element == data; });
+            }
+        }
 
     public:
-        MyContainer() : head(nullptr)
+        MyContainer() : generation(1), sortedGeneration(0)
+        {
+        }
+
+        /**
+         * Creates an empty container whose storage uses the given allocator.
+         * @param allocator - the allocator the storage rebinds for its nodes
+         */
+        explicit MyContainer(const Allocator &allocator) : storage(allocator), generation(1), sortedGeneration(0)
+        {
+        }
+
+        /**
+         * Creates an empty container that sorts by the given order, e.g. with the type of a
+         * lambda as Projection: MyContainer<Person, LinkedStorage, std::allocator<Person>,
+         * std::less<>, decltype(byAge)> people(std::less<>(), byAge);
+         * @param compare - orders the keys
+         * @param projection - gives the key of an element
+         * @param allocator - the allocator the storage rebinds for its nodes
+         */
+        explicit MyContainer(const Compare &compare, const Projection &projection = Projection(),
+                             const Allocator &allocator = Allocator())
+            : storage(allocator), generation(1), sortedGeneration(0), compare(compare), projection(projection)
+        {
+        }
+
+        /**
+         * Creates a container holding the elements of [first, last) in order, see add_range().
+         * @param first, last - the range of elements to copy in
+         * @param allocator - the allocator the storage rebinds for its nodes
+         */
+        template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+        MyContainer(InputIt first, InputIt last, const Allocator &allocator = Allocator())
+            : MyContainer(allocator)
+        {
+            add_range(first, last);
+        }
+
+        /**
+         * Creates a container holding the given elements in order, e.g. MyContainer<int> c{3, 1, 2};
+         * @param values - the elements to copy in
+         * @param allocator - the allocator the storage rebinds for its nodes
+         */
+        MyContainer(std::initializer_list<T> values, const Allocator &allocator = Allocator())
+            : MyContainer(values.begin(), values.end(), allocator)
+        {
+        }
+
+        /**
+         * Copies the elements of other, the copy builds its own orderings.
+         */
+        MyContainer(const MyContainer &other)
+            : storage(other.storage), generation(1), sortedGeneration(0), sortOptions(other.sortOptions),
+              compare(other.compare), projection(other.projection)
         {
+            if (other.index)
+                index = std::make_unique<Index>(storage, storage.get_allocator());
         }
 
-        ~MyContainer()
+        MyContainer &operator=(const MyContainer &other)
         {
-            if (head != nullptr)
+            if (this != &other)
             {
-                Node *tail = head;
-                while (head != nullptr)
+                // Lambdas can't be assigned. One without captures orders the same way in every
+                // container and is kept, one with captures would silently keep the old order
+                static_assert(std::is_copy_assignable<Compare>::value || std::is_empty<Compare>::value,
+                              "copy assignment needs a Compare that is assignable or stateless");
+                static_assert(std::is_copy_assignable<Projection>::value || std::is_empty<Projection>::value,
+                              "copy assignment needs a Projection that is assignable or stateless");
+                storage = other.storage;
+                sortOptions = other.sortOptions;
+                if constexpr (std::is_copy_assignable<Compare>::value)
+                    compare = other.compare;
+                if constexpr (std::is_copy_assignable<Projection>::value)
+                    projection = other.projection;
+                index.reset();
+                if (other.index)
+                    index = std::make_unique<Index>(storage, storage.get_allocator());
+                sortedCache.reset();
+                ++generation;
+            }
+            return *this;
+        }
+
+        /**
+         * Takes over other's elements together with its index and its cached sort, which
+         * stay valid because the elements themselves don't move. other is left empty.
+         */
+        MyContainer(MyContainer &&other) noexcept(std::is_nothrow_move_constructible<Elements>::value &&
+                                                  std::is_nothrow_move_constructible<Compare>::value &&
+                                                  std::is_nothrow_move_constructible<Projection>::value)
+            : storage(std::move(other.storage)), index(std::move(other.index)), generation(other.generation),
+              sortedCache(std::move(other.sortedCache)), sortedGeneration(other.sortedGeneration),
+              sortOptions(other.sortOptions), compare(std::move(other.compare)),
+              projection(std::move(other.projection))
+        {
+            ++other.generation;
+        }
+
+        /**
+         * Takes over other's elements. The index and the cached sort come along when the
+         * storage could take other's memory as it is (the allocator propagates or both are
+         * equal); otherwise the elements were moved one by one and both are rebuilt.
+         */
+        MyContainer &operator=(MyContainer &&other)
+        {
+            if (this == &other)
+                return *this;
+
+            using AllocatorTraits = std::allocator_traits<Allocator>;
+            const bool taken = AllocatorTraits::propagate_on_container_move_assignment::value ||
+                               storage.get_allocator() == other.storage.get_allocator();
+            const bool cached = other.sortedCache && other.sortedGeneration == other.generation;
+            // Lambdas can't be assigned, see the copy assignment
+            static_assert(std::is_move_assignable<Compare>::value || std::is_empty<Compare>::value,
+                          "move assignment needs a Compare that is assignable or stateless");
+            static_assert(std::is_move_assignable<Projection>::value || std::is_empty<Projection>::value,
+                          "move assignment needs a Projection that is assignable or stateless");
+            storage = std::move(other.storage);
+            sortOptions = other.sortOptions;
+            if constexpr (std::is_move_assignable<Compare>::value)
+                compare = std::move(other.compare);
+            if constexpr (std::is_move_assignable<Projection>::value)
+                projection = std::move(other.projection);
+
+            ++generation;
+            if (taken)
+            {
+                index = std::move(other.index);
+                sortedCache.reset();
+                // An uncached source leaves sortedGeneration behind generation, so the next
+                // sorted order builds its own
+                if (cached)
                 {
-                    head = head->next;
-                    delete tail;
-                    tail = head;
+                    sortedCache = std::move(other.sortedCache);
+                    sortedGeneration = generation;
                 }
             }
+            else
+            {
+                index.reset();
+                if (other.index)
+                    index = std::make_unique<Index>(storage, storage.get_allocator());
+                sortedCache.reset();
+            }
+
+            other.storage.clear();
+            if (other.index)
+                other.index->clear();
+            other.sortedCache.reset();
+            ++other.generation;
+            return *this;
         }
 
         /**
          * This function is responsible for adding data of a specific type to the container
-         * @param data - the data that will be added to the container
+         * @param data - the data that will be copied into the container
          */
-        void add(T data)
+        void add(const T &data)
         {
-            if (head == nullptr)
+            index_added(storage.emplace_back(data));
+            ++generation;
+        }
+
+        /**
+         * Adds data to the container by moving it, so movable types are never copied
+         * @param data - the data that will be moved into the container
+         */
+        void add(T &&data)
+        {
+            index_added(storage.emplace_back(std::move(data)));
+            ++generation;
+        }
+
+        /**
+         * Constructs a new element directly inside the container from the given arguments
+         * @param args - the constructor arguments of the element
+         * @return the new element, which may only be changed in ways that keep its order and
+         * equality, like through the insertion-order iterator
+         */
+        template<typename... Args>
+        T &emplace(Args &&...args)
+        {
+            T &element = storage.emplace_back(std::forward<Args>(args)...);
+            index_added(element);
+            ++generation;
+            return element;
+        }
+
+        /**
+         * Adds every element of [first, last) in order. When the size of the range is known
+         * (forward iterators) the storage for the whole batch is allocated at once and the
+         * elements are linked in a single pass.
+         * @param first, last - the range of elements to copy in
+         */
+        template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+        void add_range(InputIt first, InputIt last)
+        {
+            if (!index)
             {
-                head = new Node(data);
+                if (storage.append_range(first, last) != 0)
+                    ++generation;
                 return;
             }
 
-            Node *temp = head;
-            while (temp->next)
-                temp = temp->next;
+            // Every new element has to be indexed, so they are added one by one into room
+            // reserved for the batch
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value)
+                storage.reserve(storage.size() + static_cast<std::size_t>(std::distance(first, last)));
+            for (; first != last; ++first)
+                add(*first);
+        }
 
-            temp->next = new Node(data);
+        /**
+         * Allocates room for n elements ahead of time, so adding up to n elements doesn't
+         * allocate for each one.
+         * @param n - the number of elements to make room for
+         */
+        void reserve(std::size_t n)
+        {
+            storage.reserve(n);
+            // ContiguousStorage may have moved its elements, which the sorted orders point to
+            if constexpr (!Elements::stable_cursors)
+                ++generation;
         }
 
         /**
@@ -70,57 +389,207 @@ namespace customContainer
          */
         void remove(const T &data)
         {
-            if (head == nullptr)
-                throw std::out_of_range("Container is empty");
+            if (storage.size() == 0)
+                fail("Container is empty");
+
+            if (try_remove(data) == 0)
+                fail("Element not found");
+        }
+
+        /**
+         * Removes every element equal to data like remove(), but a missing element or an
+         * empty container is simply reported by returning 0, nothing is thrown.
+         * @param data - the data to remove from the container
+         * @return how many elements were removed
+         */
+        std::size_t try_remove(const T &data)
+        {
+            if (storage.size() == 0)
+                return 0;
 
-            bool found = false;
-            while (head && head->data == data)
+            std::size_t removed = index ? remove_indexed(data)
+                                        : storage.erase_if([&data](const T &element) { return element == data; });
+            if (removed != 0)
+                ++generation;
+            return removed;
+        }
+
+        /**
+         * Removes every element matching the predicate in a single pass over the container.
+         * Unlike remove(), nothing is thrown when no element matches.
+         * @param pred - callable taking a const T& and returning true for elements to remove
+         * @return how many elements were removed
+         */
+        template<typename Predicate>
+        std::size_t remove_if(Predicate pred)
+        {
+            std::size_t removed;
+            if (index)
             {
-                Node *tmp = head;
-                head = head->next;
-                delete tmp;
-                found = true;
+                removed = storage.erase_if([this, &pred](const T &element) {
+                    if (!pred(element))
+                        return false;
+                    index->removed(element);
+                    return true;
+                });
+                index->refresh(storage);
             }
-
-            // remove matches in the rest of the list
-            Node *cur = head;
-            while (cur && cur->next)
+            else
             {
-                if (cur->next->data == data)
-                {
-                    Node *toDel = cur->next;
-                    cur->next = toDel->next; // skip it
-                    delete toDel;
-                    found = true;
-                }
-                else
-                {
-                    cur = cur->next;
-                }
+                removed = storage.erase_if([&pred](const T &element) { return pred(element); });
             }
 
-            if (!found)
-                throw std::out_of_range("Element not found");
+            if (removed != 0)
+                ++generation;
+            return removed;
         }
 
         /**
-         * This counts how many elements exist in the container
-         * @return the size of the container
+         * Removes every element equal to any of the given values. The values are put in a
+         * small hash set (when T can be hashed) and the container is walked once, instead of
+         * once per value. With an index over LinkedStorage only the matches are visited.
+         * Values that aren't in the container are skipped, nothing is thrown.
+         * @param values - any range of values, e.g. a std::vector<T>
+         * @return how many elements were removed
          */
-        std::size_t size() const
+        template<typename Range>
+        std::size_t remove_all(const Range &values)
         {
-            if (head == nullptr)
+            using std::begin;
+            using std::end;
+            if (storage.size() == 0 || begin(values) == end(values))
                 return 0;
 
-            int count = 0;
-            Node *temp = head;
-            while (temp != nullptr)
+            if constexpr (Index::TracksPositions)
             {
-                count++;
-                temp = temp->next;
+                if (index)
+                {
+                    std::size_t removed = 0;
+                    for (const T &value : values)
+                        removed += remove_indexed(value);
+                    if (removed != 0)
+                        ++generation;
+                    return removed;
+                }
+            }
+
+            if constexpr (is_hashable<T>::value)
+            {
+                const std::unordered_set<T> probe(begin(values), end(values));
+                return remove_if([&probe](const T &element) { return probe.count(element) != 0; });
             }
+            else
+            {
+                return remove_if([&values](const T &element) {
+                    for (const T &value : values)
+                        if (element == value)
+                            return true;
+                    return false;
+                });
+            }
+        }
+
+        /**
+         * Removes every element equal to any of the listed values, e.g. remove_all({1, 2, 3}).
+         * @return how many elements were removed
+         */
+        std::size_t remove_all(std::initializer_list<T> values)
+        {
+            return remove_all<std::initializer_list<T>>(values);
+        }
+
+        /**
+         * Counts the elements equal to value. Constant time on average with the index,
+         * a walk over all the elements without it.
+         * @param value - the value to look for
+         * @return how many elements are equal to value
+         */
+        std::size_t count(const T &value) const
+        {
+            if (index)
+                return index->count(value);
+
+            std::size_t matches = 0;
+            storage.for_each([&](const T &element) {
+                if (element == value)
+                    ++matches;
+            });
+            return matches;
+        }
+
+        /**
+         * @param value - the value to look for
+         * @return true if at least one element is equal to value
+         */
+        bool contains(const T &value) const
+        {
+            return count(value) != 0;
+        }
+
+        /**
+         * Starts keeping a hash index from each value to its elements, built from the current
+         * elements and then kept in sync by every add and remove. With it count(), contains()
+         * and removing a missing value take constant time on average, and with LinkedStorage
+         * remove() only touches the matching elements. Needs std::hash<T>.
+         */
+        void enable_index()
+        {
+            static_assert(is_hashable<T>::value, "enable_index() needs a std::hash specialization for T");
+            if (!index)
+                index = std::make_unique<Index>(storage, storage.get_allocator());
+        }
+
+        /**
+         * Drops the value index, add and remove stop paying for it.
+         */
+        void disable_index()
+        {
+            index.reset();
+        }
+
+        /**
+         * @return true if the container keeps a value index
+         */
+        bool indexed() const
+        {
+            return index != nullptr;
+        }
+
+        /**
+         * Sets when building the sorted orders is split between threads, e.g.
+         * set_sort_options({100000, 4}) sorts 100000 elements and more on 4 threads.
+         * By default sorts of ParallelSortMinimum elements and more use every hardware thread.
+         * @param options - the smallest sort to split and the most threads to use (0 for all)
+         */
+        void set_sort_options(const SortOptions &options)
+        {
+            sortOptions = options;
+        }
+
+        /**
+         * @return the options set with set_sort_options()
+         */
+        const SortOptions &sort_options() const
+        {
+            return sortOptions;
+        }
 
-            return count;
+        /**
+         * @return a copy of the allocator given to the storage
+         */
+        Allocator get_allocator() const
+        {
+            return storage.get_allocator();
+        }
+
+        /**
+         * This returns how many elements exist in the container, the count is
+         * maintained by add() and remove() so this is constant time
+         * @return the size of the container
+         */
+        std::size_t size() const
+        {
+            return storage.size();
         }
 
         /**
@@ -130,60 +599,175 @@ namespace customContainer
          * @param container - the container to print
          * @return a stream of the output that will be printed
          */
-        friend std::ostream &operator<<(std::ostream &os, const MyContainer<T> &container)
+        friend std::ostream &operator<<(std::ostream &os, const MyContainer &container)
         {
-            if (container.head == nullptr)
+            if (container.storage.size() == 0)
                 return os;
 
-            Node *temp = container.head;
             os << "[";
-            while (temp != nullptr)
-            {
-                os << temp->data << ", ";
-                temp = temp->next;
-            }
+            container.storage.for_each([&os](const T &data) { os << data << ", "; });
             os << "]";
 
             return os;
         }
 
-        class AscendingOrder
+        /**
+         * The std::iterator_traits members and the arithmetic shared by the order iterators
+         * that know their position in the order. The iterator deriving from it provides ++,
+         * --, +=, == and position(); everything else (-=, +, -, [], <, ...) is written
+         * here in terms of those, so standard algorithms get their random-access paths.
+         * @tparam Iterator - the iterator deriving from this
+         * @tparam Category - the iterator category it declares
+         * @tparam Element - T, or const T for the orders that only read
+         */
+        template<typename Iterator, typename Category, typename Element = T>
+        class PositionIterator
+        {
+        public:
+            using iterator_category = Category;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Element *;
+            using reference = Element &;
+
+            /**
+             * Moves the iterator n positions back.
+             */
+            Iterator &operator-=(difference_type n)
+            {
+                return self() += -n;
+            }
+
+            /**
+             * @return the element n positions after this one
+             */
+            reference operator[](difference_type n) const
+            {
+                return *(self() + n);
+            }
+
+            friend Iterator operator+(Iterator it, difference_type n)
+            {
+                return it += n;
+            }
+
+            friend Iterator operator+(difference_type n, Iterator it)
+            {
+                return it += n;
+            }
+
+            friend Iterator operator-(Iterator it, difference_type n)
+            {
+                return it += -n;
+            }
+
+            /**
+             * @return how many positions b is ahead of a
+             */
+            friend difference_type operator-(const Iterator &b, const Iterator &a)
+            {
+                return static_cast<difference_type>(b.position()) - static_cast<difference_type>(a.position());
+            }
+
+            friend Iterator operator--(Iterator &it, int)
+            {
+                Iterator tmp = it;
+                --it;
+                return tmp;
+            }
+
+            friend bool operator<(const Iterator &a, const Iterator &b) { return a.position() < b.position(); }
+            friend bool operator>(const Iterator &a, const Iterator &b) { return b < a; }
+            friend bool operator<=(const Iterator &a, const Iterator &b) { return !(b < a); }
+            friend bool operator>=(const Iterator &a, const Iterator &b) { return !(a < b); }
+
+        private:
+            Iterator &self() { return static_cast<Iterator &>(*this); }
+            const Iterator &self() const { return static_cast<const Iterator &>(*this); }
+        };
+
+        /// Reverse and middle-out are random access on ContiguousStorage, where the storage
+        /// reaches any position at once; on the other storages a jump walks the elements.
+        using CursorCategory = std::conditional_t<Elements::random_access, std::random_access_iterator_tag,
+                                                  std::bidirectional_iterator_tag>;
+
+        /**
+         * A range over the container in one of the iteration orders, so it can be used
+         * in a range-based for loop: for (int x : container.ascending()) ...
+         * Every begin() starts from the container as it is now, so a view stays valid
+         * across add() and remove(); the sorted orders still share the container's cached
+         * sort. end() is a sentinel that doesn't build or allocate anything.
+         */
+        template<typename Iterator>
+        class OrderView
         {
         private:
             MyContainer *container;
-            std::vector<Node *> sortedList;
+
+        public:
+            explicit OrderView(MyContainer &container) : container(&container)
+            {
+            }
+
+            /**
+             * Returns an iterator at the first element of the container's current contents.
+             */
+            Iterator begin() const
+            {
+                return Iterator(*container, true);
+            }
+
+            /**
+             * Returns the end sentinel of the order.
+             */
+            Iterator end() const
+            {
+                return Iterator(*container, false);
+            }
+        };
+
+        class AscendingOrder : public PositionIterator<AscendingOrder, std::random_access_iterator_tag, const T>
+        {
+        private:
+            MyContainer *container;
+            mutable SharedSorted sortedList; /// Fetched on first use, see list()
             std::size_t index;
 
+            /**
+             * The sorted order, fetched the first time it is needed so the end iterator
+             * stays a sentinel until something steps back from it.
+             */
+            SortedElements &list() const
+            {
+                if (!sortedList)
+                    sortedList = container->sorted_elements();
+                return *sortedList;
+            }
+
         public:
             explicit AscendingOrder() : container(nullptr), index(0)
             {
             }
             
             /**
-             * This function is responsible for sorting in ascending order the data 
-             * in the container when the iterator is created. So later when we iterate
-             * the information will be sorted.
+             * This function is responsible for taking the ascending order of the data
+             * in the container when the iterator is created. The order comes from the
+             * container's cached sorted permutation, so it is only sorted again after a change,
+             * and only as far as the iterators read it.
              * @param container - the container we iterate through
              * @param atBegin - a boolean value if we return the beginning of the iteration or the end
              * @return an iterator at the begin or end value
              */
             AscendingOrder(MyContainer &container, bool atBegin) : container(&container), index(0)
             {
-                Node *temp = container.head;
-                while (temp != nullptr)
+                // The end iterator is a sentinel, it only fetches the sorted list if stepped back
+                if (!atBegin)
                 {
-                    // Add all nodes to the list
-                    sortedList.push_back(temp);
-                    temp = temp->next;
+                    index = container.storage.size();
+                    return;
                 }
 
-                // Sort the list by ascending order as defined in the function
-                std::sort(sortedList.begin(), sortedList.end(),
-                          [](Node *a, Node *b) { return a->data < b->data; });
-
-                // If the constructor was called from end then return the index past the last
-                if (!atBegin)
-                    index = sortedList.size();
+                sortedList = container.sorted_elements();
             }
 
             /**
@@ -196,22 +780,49 @@ namespace customContainer
                 return *this;
             }
 
+            /**
+             * Steps back to the previous (smaller) element.
+             */
+            AscendingOrder &operator--()
+            {
+                --index;
+                return *this;
+            }
+
+            /**
+             * Jumps n positions ahead, or back for a negative n.
+             */
+            AscendingOrder &operator+=(std::ptrdiff_t n)
+            {
+                index += static_cast<std::size_t>(n);
+                return *this;
+            }
+
+            /**
+             * @return the position in the order, 0 for the smallest element
+             */
+            std::size_t position() const
+            {
+                return index;
+            }
+
             /**
              * This operator overloading is responsible for accessing the current
-             * data in the iteration.
+             * data in the iteration. The element is read-only: a change would go past the
+             * cached sort all the sorted orders share.
              */
-            T &operator*() const
+            const T &operator*() const
             {
-                return sortedList[index]->data;
+                return *list().at(index);
             }
 
             /**
              * This operator overloading is responsible for derefencing the current
              * data in the iteration and returning the value.
              */
-            T *operator->() const
+            const T *operator->() const
             {
-                return &(sortedList[index]->data);
+                return list().at(index);
             }
 
 
@@ -245,16 +856,28 @@ namespace customContainer
             }
         };
 
-        AscendingOrder begin_ascending_order() { return AscendingOrder(*this, true); }
-        AscendingOrder end_ascending_order() { return AscendingOrder(*this, false); }
+        using AscendingView = OrderView<AscendingOrder>;
+
+        /// @brief View over the elements from the smallest to the largest.
+        AscendingView ascending() { return AscendingView(*this); }
 
-        class DescendingOrder
+        AscendingOrder begin_ascending_order() { return ascending().begin(); }
+        AscendingOrder end_ascending_order() { return ascending().end(); }
+
+        class DescendingOrder : public PositionIterator<DescendingOrder, std::random_access_iterator_tag, const T>
         {
         private:
             MyContainer *container;
-            std::vector<Node *> sortedList;
+            mutable SharedSorted sortedList; /// Fetched on first use, like in AscendingOrder
             std::size_t index;
 
+            SortedElements &list() const
+            {
+                if (!sortedList)
+                    sortedList = container->sorted_elements();
+                return *sortedList;
+            }
+
         public:
             /**
              * Default (end) constructor.
@@ -263,6 +886,8 @@ namespace customContainer
 
             /**
              * Builds a descending‐order iterator over the given container.
+             * It walks the container's cached ascending permutation backwards, which sorts
+             * the largest elements first.
              * @param container The container whose nodes will be iterated.
              * @param atBegin If true, positions iterator at the first (largest) element.
              * if false, positions it just past the last element.
@@ -270,15 +895,13 @@ namespace customContainer
             DescendingOrder(MyContainer &container, bool atBegin)
                 : container(&container), index(0)
             {
-                Node *temp = container.head;
-                while (temp) {
-                    sortedList.push_back(temp);
-                    temp = temp->next;
-                }
-                std::sort(sortedList.begin(), sortedList.end(),
-                        [](Node *a, Node *b) { return a->data > b->data; });
                 if (!atBegin)
-                    index = sortedList.size();
+                {
+                    index = container.storage.size();
+                    return;
+                }
+
+                sortedList = container.sorted_elements();
             }
 
             /**
@@ -290,20 +913,46 @@ namespace customContainer
                 return *this;
             }
 
+            /**
+             * Prefix decrement: step back to the previous (larger) element.
+             */
+            DescendingOrder &operator--()
+            {
+                --index;
+                return *this;
+            }
+
+            /**
+             * Jumps n positions ahead, or back for a negative n.
+             */
+            DescendingOrder &operator+=(std::ptrdiff_t n)
+            {
+                index += static_cast<std::size_t>(n);
+                return *this;
+            }
+
+            /**
+             * @return the position in the order, 0 for the largest element
+             */
+            std::size_t position() const
+            {
+                return index;
+            }
+
             /**
              * Dereference to obtain the current element by reference.
              */
-            T &operator*() const
+            const T &operator*() const
             {
-                return sortedList[index]->data;
+                return *list().at(list().size() - 1 - index);
             }
 
             /**
              * Member access: pointer to the current element’s data.
              */
-            T *operator->() const
+            const T *operator->() const
             {
-                return &(sortedList[index]->data);
+                return list().at(list().size() - 1 - index);
             }
 
             /**
@@ -333,19 +982,37 @@ namespace customContainer
             }
         };
 
+        using DescendingView = OrderView<DescendingOrder>;
+
+        /// @brief View over the elements from the largest to the smallest.
+        DescendingView descending() { return DescendingView(*this); }
+
         /// @brief Return iterator to first (largest) element in descending order.
-        DescendingOrder begin_descending_order() { return DescendingOrder(*this, true); }
+        DescendingOrder begin_descending_order() { return descending().begin(); }
         /// @brief Return iterator just past the last element.
-        DescendingOrder end_descending_order()   { return DescendingOrder(*this, false); }
+        DescendingOrder end_descending_order()   { return descending().end(); }
 
 
-    class SideCrossOrder
+    class SideCrossOrder : public PositionIterator<SideCrossOrder, std::random_access_iterator_tag, const T>
         {
         private:
             MyContainer *container;
-            std::vector<Node *> crossList;
+            mutable SharedSorted crossList; /// Elements in ascending order, fetched on first use
             std::size_t index;
 
+            /**
+             * Maps the position in the cross pattern to the ascending position:
+             * step 2k is the k-th smallest and step 2k+1 is the k-th largest.
+             */
+            T *current() const
+            {
+                if (!crossList)
+                    crossList = container->sorted_elements();
+                if (index % 2 == 0)
+                    return crossList->at(index / 2);
+                return crossList->at(crossList->size() - 1 - index / 2);
+            }
+
         public:
             /**
              * Default (end) constructor.
@@ -354,32 +1021,23 @@ namespace customContainer
 
             /**
              * Builds a “side‐cross” (min, max, next‐min, next‐max, etc...) iterator.
+             * The pattern is index arithmetic over the container's cached ascending
+             * permutation: even steps take from the front and odd steps from the back.
+             * The permutation is lazy at both ends, so reading the first k steps only
+             * sorts the k/2 smallest and k/2 largest elements.
              * @param container The container to iterate.
              * @param atBegin If true, start at the first element in cross‐pattern;
              * if false, position just past the end.
              */
             SideCrossOrder(MyContainer &container, bool atBegin) : container(&container), index(0)
             {
-                Node *temp = container.head;
-                while (temp) 
+                if (!atBegin)
                 {
-                    crossList.push_back(temp);
-                    temp = temp->next;
+                    index = container.storage.size();
+                    return;
                 }
-                std::sort(crossList.begin(), crossList.end(),
-                        [](Node *a, Node *b) { return a->data < b->data; });
-
-                std::vector<Node *> pattern;
-                int left = 0, right = int(crossList.size()) - 1;
-                while (left <= right) {
-                    pattern.push_back(crossList[left++]);
-                    if (left <= right) {
-                        pattern.push_back(crossList[right--]);
-                    }
-                }
-                crossList = std::move(pattern);
-                if (!atBegin)
-                    index = crossList.size();
+
+                crossList = container.sorted_elements();
             }
 
             /**
@@ -391,20 +1049,46 @@ namespace customContainer
                 return *this;
             }
 
+            /**
+             * Prefix decrement: step back in the cross pattern.
+             */
+            SideCrossOrder &operator--()
+            {
+                --index;
+                return *this;
+            }
+
+            /**
+             * Jumps n steps ahead in the cross pattern, or back for a negative n.
+             */
+            SideCrossOrder &operator+=(std::ptrdiff_t n)
+            {
+                index += static_cast<std::size_t>(n);
+                return *this;
+            }
+
+            /**
+             * @return the step of the cross pattern the iterator is at
+             */
+            std::size_t position() const
+            {
+                return index;
+            }
+
             /**
              * Dereference to obtain current element.
              */
-            T &operator*() const
+            const T &operator*() const
             {
-                return crossList[index]->data;
+                return *current();
             }
 
             /**
              * Member access: pointer to current element’s data.
              */
-            T *operator->() const
+            const T *operator->() const
             {
-                return &(crossList[index]->data);
+                return current();
             }
 
             /**
@@ -434,38 +1118,40 @@ namespace customContainer
             }
         };
 
+        using SideCrossView = OrderView<SideCrossOrder>;
+
+        /// @brief View over the elements in side-cross order.
+        SideCrossView side_cross() { return SideCrossView(*this); }
+
         /// @brief Iterator to the first element in side-cross order.
-        SideCrossOrder begin_side_cross_order() { return SideCrossOrder(*this, true); }
+        SideCrossOrder begin_side_cross_order() { return side_cross().begin(); }
         /// @brief Iterator just past the last element.
-        SideCrossOrder end_side_cross_order()   { return SideCrossOrder(*this, false); }
+        SideCrossOrder end_side_cross_order()   { return side_cross().end(); }
 
 
-    class ReverseOrder
+    class ReverseOrder : public PositionIterator<ReverseOrder, CursorCategory>
         {
         private:
-            std::vector<Node *> reverseList;
-            int index;
+            MyContainer *container;
+            Cursor current;    /// The current element, the storage's end() once past the first
+            std::size_t index; /// Position in the order, 0 for the last inserted element
 
         public:
             /**
              * Default (end) constructor.
              */
-            ReverseOrder() : index(-1) {}
+            ReverseOrder() : container(nullptr), current(), index(0) {}
 
             /**
-             * Builds a reverse (tail -> head) iterator.
+             * Builds a reverse (tail -> head) iterator. It steps back through the storage
+             * itself, so creating it allocates nothing.
              * @param container The container whose list to reverse‐iterate.
              * @param atBegin If true, positions at last element; if false, just before first.
              */
-            ReverseOrder(const MyContainer &container, bool atBegin)
-                : index(-1)
+            ReverseOrder(MyContainer &container, bool atBegin)
+                : container(&container), current(atBegin ? container.storage.last() : container.storage.end()),
+                  index(atBegin ? 0 : container.storage.size())
             {
-                Node *temp = container.head;
-                while (temp) {
-                    reverseList.push_back(temp);
-                    temp = temp->next;
-                }
-                index = atBegin ? int(reverseList.size()) - 1 : -1;
             }
 
             /**
@@ -473,7 +1159,7 @@ namespace customContainer
              */
             T &operator*() const
             {
-                return reverseList[index]->data;
+                return *current;
             }
 
             /**
@@ -481,7 +1167,7 @@ namespace customContainer
              */
             T *operator->() const
             {
-                return &reverseList[index]->data;
+                return &*current;
             }
 
             /**
@@ -489,17 +1175,60 @@ namespace customContainer
              */
             ReverseOrder &operator++()
             {
-                --index;
+                current = container->storage.before(current);
+                ++index;
                 return *this;
             }
 
+            /**
+             * Prefix decrement (steps forwards in the list, from the end back to the first element).
+             */
+            ReverseOrder &operator--()
+            {
+                if (index-- == container->storage.size())
+                    current = container->storage.begin();
+                else
+                    ++current;
+                return *this;
+            }
+
+            /**
+             * Jumps n positions ahead, or back for a negative n. Only ContiguousStorage
+             * jumps at once, the other storages step there one element at a time.
+             */
+            ReverseOrder &operator+=(std::ptrdiff_t n)
+            {
+                if constexpr (Elements::random_access)
+                {
+                    Elements &storage = container->storage;
+                    index += static_cast<std::size_t>(n);
+                    current = index == storage.size() ? storage.end() : storage.at(storage.size() - 1 - index);
+                }
+                else
+                {
+                    for (; n > 0; --n)
+                        ++(*this);
+                    for (; n < 0; ++n)
+                        --(*this);
+                }
+                return *this;
+            }
+
+            /**
+             * @return the position in the order, 0 for the last inserted element
+             */
+            std::size_t position() const
+            {
+                return index;
+            }
+
             /**
              * Postfix increment.
              */
             ReverseOrder operator++(int)
             {
                 ReverseOrder tmp = *this;
-                --index;
+                ++(*this);
                 return tmp;
             }
 
@@ -508,7 +1237,7 @@ namespace customContainer
              */
             bool operator==(const ReverseOrder &o) const
             {
-                return index == o.index;
+                return index == o.index && container == o.container;
             }
 
             /**
@@ -520,34 +1249,47 @@ namespace customContainer
             }
         };
 
+        using ReverseView = OrderView<ReverseOrder>;
+
+        /// @brief View over the elements from the last inserted to the first.
+        ReverseView reverse() { return ReverseView(*this); }
+
         /// @brief Reverse‐order begin iterator.
-        ReverseOrder begin_reverse_order() { return ReverseOrder(*this, true); }
+        ReverseOrder begin_reverse_order() { return reverse().begin(); }
         /// @brief Reverse‐order end iterator.
-        ReverseOrder end_reverse_order()   { return ReverseOrder(*this, false); }
+        ReverseOrder end_reverse_order()   { return reverse().end(); }
 
 
 
     class Order {
         private:
-            Node* current;  // Pointer to the current node in the list
+            Cursor current;  // The current position in the storage
 
         public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T *;
+            using reference = T &;
+
             /**
-             * Construct an iterator pointing to the given node.
-             * @param node The node at which to start iteration (nullptr for end).
+             * Construct an iterator pointing to the given storage position.
+             * @param position The position at which to start iteration (the storage end for end).
              */
-            explicit Order(Node* node = nullptr)
-                : current(node)
+            explicit Order(Cursor position = Cursor())
+                : current(position)
             {
             }
 
             /**
              * Dereference operator: access the value at the current iterator position.
+             * The container doesn't see writes through it, so they must not change how the
+             * element sorts or compares: the sorted orders and the index would go stale.
              * @return Reference to the element stored in the current node.
              */
             T& operator*() const
             {
-                return current->data;
+                return *current;
             }
 
             /**
@@ -556,7 +1298,7 @@ namespace customContainer
              */
             T* operator->() const
             {
-                return &(current->data);
+                return &(*current);
             }
 
             /**
@@ -565,7 +1307,7 @@ namespace customContainer
              */
             Order& operator++()
             {
-                current = current->next;
+                ++current;
                 return *this;
             }
 
@@ -605,86 +1347,167 @@ namespace customContainer
          * Get an iterator to the first element in insertion order.
          * @return Order iterator at the beginning.
          */
-        Order begin_order() { return Order(head); }
+        Order begin_order() { return Order(storage.begin()); }
 
         /**
          * Get an iterator one past the last element in insertion order.
-         * @return Order iterator at the end (nullptr).
+         * @return Order iterator at the end.
          */
-        Order end_order()   { return Order(nullptr); }
+        Order end_order()   { return Order(storage.end()); }
+
+        /**
+         * Looks for the first element equal to value in insertion order. With the value
+         * index a missing value is answered without walking the container.
+         * @param value - the value to look for
+         * @return an Order iterator at the element, or end_order() if there is none
+         */
+        Order find(const T &value)
+        {
+            if (index && index->count(value) == 0)
+                return end_order();
+
+            Cursor pos = storage.begin();
+            while (pos != storage.end() && !(*pos == value))
+                ++pos;
+            return Order(pos);
+        }
 
     /**
      * Iterator that starts from the middle of the container and alternates outward.
      */
-    class MiddleOutOrder {
+    class MiddleOutOrder : public PositionIterator<MiddleOutOrder, CursorCategory> {
         private:
-            std::vector<Node*> middleList;  /// Nodes arranged in middle-out sequence
+            MyContainer *container;
+            Cursor current;                 /// The element at the current position
+            Cursor left;                    /// The leftmost element visited so far
+            Cursor right;                   /// The rightmost element visited so far
             std::size_t index;              /// Current position in the sequence
 
+            /**
+             * Places the cursors for position min(index, n - 1) of the sequence. Step k
+             * takes the element k/2 right of the middle for even k, and (k+1)/2 left of it
+             * for odd k; the left side is never shorter, so the sides always alternate.
+             */
+            void seek()
+            {
+                Elements &storage = container->storage;
+                const std::size_t k = std::min(index, storage.size() - 1);
+                const std::size_t mid = storage.size() / 2;
+                left = storage.at(mid - (k + 1) / 2);
+                right = storage.at(mid + k / 2);
+                current = k % 2 == 1 ? left : right;
+            }
+
         public:
             /**
              * Default constructor: creates an invalid iterator.
              */
             explicit MiddleOutOrder()
-                : index(0)
+                : container(nullptr), index(0)
             {
             }
 
             /**
-             * Construct a middle-out iterator over the given container.
+             * Construct a middle-out iterator over the given container. It walks outwards
+             * from the middle element with two storage cursors, so creating it allocates
+             * nothing; the end iterator doesn't even look for the middle.
              * @param container The container whose nodes to traverse.
              * @param atBegin If true, iterator starts at the middle; if false, at end.
              */
-            MiddleOutOrder(const MyContainer& container, bool atBegin) : index(0)
+            MiddleOutOrder(MyContainer& container, bool atBegin)
+                : container(&container), current(container.storage.end()), left(container.storage.end()),
+                  right(container.storage.end()), index(0)
+            {
+                if (!atBegin || container.storage.size() == 0) {
+                    index = container.storage.size();
+                    return;
+                }
+
+                current = left = right = container.storage.at(container.storage.size() / 2);
+            }
+
+            /**
+             * Pre‐increment operator: move to the next position in middle-out order, one
+             * more element to the left after the middle or a right step, one more to the right
+             * after a left step. The end keeps the cursors of the last element.
+             * @return Reference to this iterator after increment.
+             */
+            MiddleOutOrder& operator++()
             {
-                // Collect all nodes in insertion order
-                Node* temp = container.head;
-                std::vector<Node*> allNodes;
-                while (temp) {
-                    allNodes.push_back(temp);
-                    temp = temp->next;
+                Elements &storage = container->storage;
+                if (++index == storage.size())
+                    return *this;
+
+                if (index % 2 == 1) {
+                    left = storage.before(left);
+                    current = left;
+                } else {
+                    ++right;
+                    current = right;
                 }
+                return *this;
+            }
 
-                // Build the middle-out sequence
-                if (!allNodes.empty()) {
-                    std::size_t mid = allNodes.size() / 2;
-                    middleList.push_back(allNodes[mid]);
-
-                    int left  = static_cast<int>(mid) - 1;
-                    int right = static_cast<int>(mid) + 1;
-                    while (left >= 0 || right < static_cast<int>(allNodes.size())) {
-                        if (left >= 0) {
-                            middleList.push_back(allNodes[left--]);
-                        }
-                        if (right < static_cast<int>(allNodes.size())) {
-                            middleList.push_back(allNodes[right++]);
-                        }
-                    }
+            /**
+             * Pre‐decrement operator: move back to the previous position, undoing the last
+             * step. The end iterator built by end() first looks up the last element.
+             * @return Reference to this iterator after decrement.
+             */
+            MiddleOutOrder& operator--()
+            {
+                Elements &storage = container->storage;
+                if (index == storage.size()) {
+                    if (left == storage.end())
+                        seek();
+                    --index;
+                    return *this;
                 }
 
-                // If end iterator requested, position past last element
-                if (!atBegin) {
-                    index = middleList.size();
+                if (index-- % 2 == 1) {
+                    ++left;
+                    current = right;
+                } else {
+                    right = storage.before(right);
+                    current = left;
                 }
+                return *this;
             }
 
             /**
-             * Pre‐increment operator: move to the next position in middle-out order.
-             * @return Reference to this iterator after increment.
+             * Jumps n positions ahead, or back for a negative n. Only ContiguousStorage
+             * jumps at once, the other storages step there one element at a time.
+             * @return Reference to this iterator after the jump.
              */
-            MiddleOutOrder& operator++()
+            MiddleOutOrder& operator+=(std::ptrdiff_t n)
             {
-                ++index;
+                if constexpr (Elements::random_access) {
+                    index += static_cast<std::size_t>(n);
+                    if (container->storage.size() > 0)
+                        seek();
+                } else {
+                    for (; n > 0; --n)
+                        ++(*this);
+                    for (; n < 0; ++n)
+                        --(*this);
+                }
                 return *this;
             }
 
+            /**
+             * @return the position in the middle-out sequence, 0 for the middle element
+             */
+            std::size_t position() const
+            {
+                return index;
+            }
+
             /**
              * Dereference operator: access the value at the current middle-out position.
              * @return Reference to the element at the iterator’s position.
              */
             T& operator*() const
             {
-                return middleList[index]->data;
+                return *current;
             }
 
             /**
@@ -693,7 +1516,7 @@ namespace customContainer
              */
             T* operator->() const
             {
-                return &(middleList[index]->data);
+                return &*current;
             }
 
             /**
@@ -732,12 +1555,33 @@ namespace customContainer
          * Get a middle-out iterator starting at the middle element.
          * @return MiddleOutOrder at begin.
          */
-        MiddleOutOrder begin_middle_out_order() { return MiddleOutOrder(*this, true); }
+        MiddleOutOrder begin_middle_out_order() { return middle_out().begin(); }
 
         /**
          * Get a middle-out iterator positioned past the last element.
          * @return MiddleOutOrder at end.
          */
-        MiddleOutOrder end_middle_out_order()   { return MiddleOutOrder(*this, false); }
+        MiddleOutOrder end_middle_out_order()   { return middle_out().end(); }
+
+        using MiddleOutView = OrderView<MiddleOutOrder>;
+
+        /**
+         * Get a view over the elements in middle-out order.
+         * @return MiddleOutView over this container.
+         */
+        MiddleOutView middle_out() { return MiddleOutView(*this); }
     };
+
+    namespace pmr
+    {
+        /**
+         * A MyContainer whose nodes and ordering lists all come from a std::pmr::memory_resource,
+         * e.g. a request-scoped std::pmr::monotonic_buffer_resource:
+         *     std::pmr::monotonic_buffer_resource arena;
+         *     customContainer::pmr::MyContainer<int> container(&arena);
+         */
+        template<typename T = int, template<typename, typename> class Storage = LinkedStorage,
+                 typename Compare = std::less<>, typename Projection = Identity>
+        using MyContainer = customContainer::MyContainer<T, Storage, std::pmr::polymorphic_allocator<T>, Compare, Projection>;
+    }
 }
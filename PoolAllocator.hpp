@@ -0,0 +1,233 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace customContainer
+    {
+    /**
+     * A slab arena for fixed-size blocks. Blocks are carved out of large slabs, freed blocks
+     * are kept on a free list of their size and handed out again, and the slabs themselves
+     * are only returned to the system when the pool is destroyed, all at once.
+     * A pool is meant to serve one container and is not thread safe.
+     */
+    class NodePool
+    {
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        /// Bookkeeping for one block size
+        struct SizeClass
+        {
+            std::size_t blockSize;
+            FreeBlock *freeList;       /// Blocks that were given back and can be reused
+            unsigned char *bumpNext;   /// Next never used block in the newest slab
+            unsigned char *bumpEnd;    /// End of the newest slab
+            std::size_t nextSlabBlocks; /// Slabs grow geometrically up to MaxSlabBlocks
+        };
+
+        static constexpr std::size_t FirstSlabBlocks = 32;
+        static constexpr std::size_t MaxSlabBlocks = 8192;
+
+        std::vector<SizeClass> classes; /// Usually one or two entries (nodes, chunks)
+        std::vector<void *> slabs;
+
+        SizeClass &size_class(std::size_t blockSize)
+        {
+            for (SizeClass &sizeClass : classes)
+                if (sizeClass.blockSize == blockSize)
+                    return sizeClass;
+
+            classes.push_back(SizeClass{blockSize, nullptr, nullptr, nullptr, FirstSlabBlocks});
+            return classes.back();
+        }
+
+    public:
+        NodePool() = default;
+        NodePool(const NodePool &) = delete;
+        NodePool &operator=(const NodePool &) = delete;
+
+        /**
+         * Frees every slab, so the cost is the number of slabs and not the number of blocks.
+         */
+        ~NodePool()
+        {
+            for (void *slab : slabs)
+                ::operator delete(slab);
+        }
+
+        /**
+         * Rounds a request up to the block size actually handed out, so every block is
+         * suitably aligned for any type that doesn't need over-alignment.
+         */
+        static std::size_t block_size(std::size_t size)
+        {
+            constexpr std::size_t align = alignof(std::max_align_t);
+            return (std::max(size, sizeof(FreeBlock)) + align - 1) / align * align;
+        }
+
+        /**
+         * Hands out a block of at least size bytes, reusing a freed block when one exists.
+         * @param size - the requested block size in bytes
+         * @return the block
+         */
+        void *allocate(std::size_t size)
+        {
+            SizeClass &sizeClass = size_class(block_size(size));
+            if (sizeClass.freeList != nullptr)
+            {
+                FreeBlock *block = sizeClass.freeList;
+                sizeClass.freeList = block->next;
+                return block;
+            }
+
+            if (sizeClass.bumpNext == sizeClass.bumpEnd)
+            {
+                std::size_t bytes = sizeClass.blockSize * sizeClass.nextSlabBlocks;
+                sizeClass.bumpNext = static_cast<unsigned char *>(::operator new(bytes));
+                sizeClass.bumpEnd = sizeClass.bumpNext + bytes;
+                slabs.push_back(sizeClass.bumpNext);
+                sizeClass.nextSlabBlocks = std::min(sizeClass.nextSlabBlocks * 2, MaxSlabBlocks);
+            }
+
+            void *block = sizeClass.bumpNext;
+            sizeClass.bumpNext += sizeClass.blockSize;
+            return block;
+        }
+
+        /**
+         * Puts a block back on the free list of its size, it is not returned to the system.
+         * @param block - a block returned by allocate(size)
+         * @param size - the size that was passed to allocate()
+         */
+        void deallocate(void *block, std::size_t size)
+        {
+            SizeClass &sizeClass = size_class(block_size(size));
+            FreeBlock *freed = ::new (block) FreeBlock{sizeClass.freeList};
+            sizeClass.freeList = freed;
+        }
+
+        /**
+         * @return how many slabs the pool holds
+         */
+        std::size_t slab_count() const
+        {
+            return slabs.size();
+        }
+    };
+
+    /**
+     * A standard allocator that takes single objects (the container nodes and chunks once it
+     * is rebound) from a NodePool. Array allocations go to the global allocator as usual.
+     * Copies and rebound copies share the same pool, the pool lives as long as any of them.
+     */
+    template<typename T>
+    class PoolAllocator
+    {
+    private:
+        template<typename U>
+        friend class PoolAllocator;
+
+        std::shared_ptr<NodePool> pool;
+
+        static constexpr bool pooled(std::size_t n)
+        {
+            return n == 1 && alignof(T) <= alignof(std::max_align_t);
+        }
+
+    public:
+        using value_type = T;
+
+        PoolAllocator() : pool(std::make_shared<NodePool>())
+        {
+        }
+
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool)
+        {
+        }
+
+        T *allocate(std::size_t n)
+        {
+            if (pooled(n))
+                return static_cast<T *>(pool->allocate(sizeof(T)));
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T *p, std::size_t n)
+        {
+            if (pooled(n))
+                pool->deallocate(p, sizeof(T));
+            else
+                std::allocator<T>().deallocate(p, n);
+        }
+
+        /**
+         * A copied container gets a pool of its own, so the two never share slabs.
+         */
+        PoolAllocator select_on_container_copy_construction() const
+        {
+            return PoolAllocator();
+        }
+
+        /**
+         * @return true if no other allocator uses this pool, so dropping this one frees it
+         */
+        bool is_sole_owner() const
+        {
+            return pool.use_count() == 1;
+        }
+
+        /**
+         * @return the pool the blocks come from
+         */
+        const NodePool &get_pool() const
+        {
+            return *pool;
+        }
+
+        template<typename U>
+        bool operator==(const PoolAllocator<U> &other) const
+        {
+            return pool == other.pool;
+        }
+
+        template<typename U>
+        bool operator!=(const PoolAllocator<U> &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * Tells a storage whether its blocks are reclaimed all at once anyway (by the pool or the
+     * memory resource behind the allocator), so trivially destructible elements don't need
+     * to be released one by one.
+     */
+    template<typename Allocator>
+    bool releases_in_bulk(const Allocator &)
+    {
+        return false;
+    }
+
+    template<typename T>
+    bool releases_in_bulk(const PoolAllocator<T> &allocator)
+    {
+        return allocator.is_sole_owner();
+    }
+
+    template<typename T>
+    bool releases_in_bulk(const std::pmr::polymorphic_allocator<T> &allocator)
+    {
+        // A monotonic arena ignores deallocation and frees everything when it is released
+        return dynamic_cast<std::pmr::monotonic_buffer_resource *>(allocator.resource()) != nullptr;
+    }
+}
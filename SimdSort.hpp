@@ -0,0 +1,394 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CUSTOM_CONTAINER_X86_SIMD 1
+#include <immintrin.h>
+#define CUSTOM_CONTAINER_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace customContainer
+    {
+    /**
+     * An AVX2 sorting kernel for 64-bit keys, optionally carrying a 64-bit value along with
+     * each key. Blocks of 16 keys are sorted inside four registers by a sorting network,
+     * then the blocks are merged pairwise with a bitonic merge network that emits four keys
+     * per step. The kernel is compiled for AVX2 through a function attribute, so the rest of
+     * the program needs no special flags, and it is only entered when the CPU reports AVX2
+     * at run time. Everywhere else available() is false and callers keep their scalar sort.
+     */
+    namespace simd
+    {
+#ifdef CUSTOM_CONTAINER_X86_SIMD
+        /**
+         * @return true if the running CPU supports AVX2, checked once
+         */
+        inline bool available()
+        {
+            static const bool avx2 = __builtin_cpu_supports("avx2");
+            return avx2;
+        }
+
+        namespace detail
+        {
+            /// Four keys, and with Payload the four values that travel with them
+            template<bool Payload>
+            struct Lanes;
+
+            template<>
+            struct Lanes<false>
+            {
+                __m256i key;
+            };
+
+            template<>
+            struct Lanes<true>
+            {
+                __m256i key;
+                __m256i value;
+            };
+
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline Lanes<Payload> load(const std::int64_t *keys, const std::int64_t *values)
+            {
+                Lanes<Payload> lanes;
+                lanes.key = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys));
+                if constexpr (Payload)
+                    lanes.value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values));
+                else
+                    (void)values;
+                return lanes;
+            }
+
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void store(const Lanes<Payload> &lanes, std::int64_t *keys, std::int64_t *values)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(keys), lanes.key);
+                if constexpr (Payload)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), lanes.value);
+                else
+                    (void)values;
+            }
+
+            /// Lane-wise compare-exchange: a keeps the smaller key of each lane, b the larger.
+            /// With Payload equal keys are ordered by value: the networks compare mirrored
+            /// lanes, and without a strict order both copies of a tie would keep one element.
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void compare_exchange(Lanes<Payload> &a, Lanes<Payload> &b)
+            {
+                __m256i swap = _mm256_cmpgt_epi64(a.key, b.key);
+                if constexpr (Payload)
+                    swap = _mm256_or_si256(swap, _mm256_and_si256(_mm256_cmpeq_epi64(a.key, b.key),
+                                                                  _mm256_cmpgt_epi64(a.value, b.value)));
+                const __m256i smaller = _mm256_blendv_epi8(a.key, b.key, swap);
+                b.key = _mm256_blendv_epi8(b.key, a.key, swap);
+                a.key = smaller;
+                if constexpr (Payload)
+                {
+                    const __m256i value = _mm256_blendv_epi8(a.value, b.value, swap);
+                    b.value = _mm256_blendv_epi8(b.value, a.value, swap);
+                    a.value = value;
+                }
+            }
+
+            template<int Control, bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline Lanes<Payload> permute(const Lanes<Payload> &x)
+            {
+                Lanes<Payload> result;
+                result.key = _mm256_permute4x64_epi64(x.key, Control);
+                if constexpr (Payload)
+                    result.value = _mm256_permute4x64_epi64(x.value, Control);
+                return result;
+            }
+
+            template<int Mask, bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline Lanes<Payload> blend(const Lanes<Payload> &a, const Lanes<Payload> &b)
+            {
+                Lanes<Payload> result;
+                result.key = _mm256_blend_epi32(a.key, b.key, Mask);
+                if constexpr (Payload)
+                    result.value = _mm256_blend_epi32(a.value, b.value, Mask);
+                return result;
+            }
+
+            /// Sorts a bitonic sequence of four keys held in one register
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void bitonic_clean(Lanes<Payload> &x)
+            {
+                // Lanes two apart, then neighbouring lanes
+                Lanes<Payload> low = x;
+                Lanes<Payload> high = permute<0x4E>(x);
+                compare_exchange(low, high);
+                x = blend<0xF0>(low, high);
+
+                low = x;
+                high = permute<0xB1>(x);
+                compare_exchange(low, high);
+                x = blend<0xCC>(low, high);
+            }
+
+            /// Merges two sorted registers: a gets the four smallest keys, b the four largest
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void merge8(Lanes<Payload> &a, Lanes<Payload> &b)
+            {
+                b = permute<0x1B>(b);
+                compare_exchange(a, b);
+                bitonic_clean(a);
+                bitonic_clean(b);
+            }
+
+            /// Merges the sorted runs (a0, a1) and (b0, b1) into the sorted run (a0, a1, b0, b1)
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void merge16(Lanes<Payload> &a0, Lanes<Payload> &a1,
+                                                      Lanes<Payload> &b0, Lanes<Payload> &b1)
+            {
+                Lanes<Payload> c0 = permute<0x1B>(b1);
+                Lanes<Payload> c1 = permute<0x1B>(b0);
+                compare_exchange(a0, c0);
+                compare_exchange(a1, c1);
+
+                compare_exchange(a0, a1);
+                bitonic_clean(a0);
+                bitonic_clean(a1);
+                compare_exchange(c0, c1);
+                bitonic_clean(c0);
+                bitonic_clean(c1);
+                b0 = c0;
+                b1 = c1;
+            }
+
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void transpose(Lanes<Payload> &r0, Lanes<Payload> &r1,
+                                                        Lanes<Payload> &r2, Lanes<Payload> &r3)
+            {
+                Lanes<Payload> t0, t1, t2, t3;
+                t0.key = _mm256_unpacklo_epi64(r0.key, r1.key);
+                t1.key = _mm256_unpackhi_epi64(r0.key, r1.key);
+                t2.key = _mm256_unpacklo_epi64(r2.key, r3.key);
+                t3.key = _mm256_unpackhi_epi64(r2.key, r3.key);
+                r0.key = _mm256_permute2x128_si256(t0.key, t2.key, 0x20);
+                r1.key = _mm256_permute2x128_si256(t1.key, t3.key, 0x20);
+                r2.key = _mm256_permute2x128_si256(t0.key, t2.key, 0x31);
+                r3.key = _mm256_permute2x128_si256(t1.key, t3.key, 0x31);
+                if constexpr (Payload)
+                {
+                    t0.value = _mm256_unpacklo_epi64(r0.value, r1.value);
+                    t1.value = _mm256_unpackhi_epi64(r0.value, r1.value);
+                    t2.value = _mm256_unpacklo_epi64(r2.value, r3.value);
+                    t3.value = _mm256_unpackhi_epi64(r2.value, r3.value);
+                    r0.value = _mm256_permute2x128_si256(t0.value, t2.value, 0x20);
+                    r1.value = _mm256_permute2x128_si256(t1.value, t3.value, 0x20);
+                    r2.value = _mm256_permute2x128_si256(t0.value, t2.value, 0x31);
+                    r3.value = _mm256_permute2x128_si256(t1.value, t3.value, 0x31);
+                }
+            }
+
+            /// Sorts 16 keys in place
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void sort16(std::int64_t *keys, std::int64_t *values)
+            {
+                Lanes<Payload> r0 = load<Payload>(keys, values);
+                Lanes<Payload> r1 = load<Payload>(keys + 4, values + 4);
+                Lanes<Payload> r2 = load<Payload>(keys + 8, values + 8);
+                Lanes<Payload> r3 = load<Payload>(keys + 12, values + 12);
+
+                // Sort every column, then the transposed rows are four sorted runs of four
+                compare_exchange(r0, r1);
+                compare_exchange(r2, r3);
+                compare_exchange(r0, r2);
+                compare_exchange(r1, r3);
+                compare_exchange(r1, r2);
+                transpose(r0, r1, r2, r3);
+
+                merge8(r0, r1);
+                merge8(r2, r3);
+                merge16(r0, r1, r2, r3);
+
+                store(r0, keys, values);
+                store(r1, keys + 4, values + 4);
+                store(r2, keys + 8, values + 8);
+                store(r3, keys + 12, values + 12);
+            }
+
+            /// (key, value) order of two elements, by key alone without Payload
+            template<bool Payload>
+            inline bool greater(const std::int64_t *keys, const std::int64_t *values, std::size_t i,
+                                const std::int64_t *otherKeys, const std::int64_t *otherValues, std::size_t j)
+            {
+                if constexpr (Payload)
+                    return keys[i] > otherKeys[j] || (keys[i] == otherKeys[j] && values[i] > otherValues[j]);
+                else
+                    return keys[i] > otherKeys[j];
+            }
+
+            /**
+             * Merges two sorted runs whose lengths are multiples of 16 into out. The smallest
+             * keys are merged from the front and the largest from the back at the same time,
+             * two independent chains of compare-exchanges that the CPU overlaps; each side
+             * stops after producing half of the output.
+             */
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 inline void merge_runs(const std::int64_t *aKeys, const std::int64_t *aValues,
+                                                         std::size_t aSize, const std::int64_t *bKeys,
+                                                         const std::int64_t *bValues, std::size_t bSize,
+                                                         std::int64_t *outKeys, std::int64_t *outValues)
+            {
+                // Front: the next unread block of each run, low holds the candidates
+                Lanes<Payload> frontLow = load<Payload>(aKeys, aValues);
+                Lanes<Payload> frontHigh = load<Payload>(bKeys, bValues);
+                std::size_t aFront = 4;
+                std::size_t bFront = 4;
+                // Back: the last unread block of each run ends at aBack / bBack
+                Lanes<Payload> backLow = load<Payload>(aKeys + aSize - 4, aValues + aSize - 4);
+                Lanes<Payload> backHigh = load<Payload>(bKeys + bSize - 4, bValues + bSize - 4);
+                std::size_t aBack = aSize - 4;
+                std::size_t bBack = bSize - 4;
+
+                std::size_t out = 0;
+                std::size_t outBack = aSize + bSize;
+                for (std::size_t step = (aSize + bSize) / 8; step > 0; --step)
+                {
+                    merge8(frontLow, frontHigh);
+                    merge8(backLow, backHigh);
+                    store(frontLow, outKeys + out, outValues + out);
+                    out += 4;
+                    outBack -= 4;
+                    store(backHigh, outKeys + outBack, outValues + outBack);
+
+                    // Which run to read next is a coin flip for the branch predictor, so it is
+                    // selected without branches. Neither side runs out of both runs before
+                    // it has produced its half of the output.
+                    const bool aFirst = !greater<Payload>(aKeys, aValues, std::min(aFront, aSize - 1), bKeys, bValues,
+                                                          std::min(bFront, bSize - 1));
+                    const bool frontA = (aFront < aSize) & ((bFront >= bSize) | aFirst);
+                    const std::size_t frontFrom = frontA ? aFront : bFront;
+                    frontLow = load<Payload>((frontA ? aKeys : bKeys) + frontFrom, (frontA ? aValues : bValues) + frontFrom);
+                    aFront += frontA ? 4 : 0;
+                    bFront += frontA ? 0 : 4;
+
+                    const bool aLast = greater<Payload>(aKeys, aValues, aBack == 0 ? 0 : aBack - 1, bKeys, bValues,
+                                                        bBack == 0 ? 0 : bBack - 1);
+                    const bool backA = (aBack > 0) & ((bBack == 0) | aLast);
+                    aBack -= backA ? 4 : 0;
+                    bBack -= backA ? 0 : 4;
+                    const std::size_t backFrom = backA ? aBack : bBack;
+                    backHigh = load<Payload>((backA ? aKeys : bKeys) + backFrom, (backA ? aValues : bValues) + backFrom);
+                }
+            }
+
+            /**
+             * Sorts n signed keys (n a multiple of 16) using scratch buffers of the same size.
+             * Without Payload the value pointers are never read.
+             */
+            template<bool Payload>
+            CUSTOM_CONTAINER_AVX2 void sort(std::int64_t *keys, std::int64_t *values, std::size_t n,
+                                            std::int64_t *scratchKeys, std::int64_t *scratchValues)
+            {
+                for (std::size_t i = 0; i < n; i += 16)
+                    sort16<Payload>(keys + i, Payload ? values + i : values);
+
+                std::int64_t *fromKeys = keys, *fromValues = values;
+                std::int64_t *toKeys = scratchKeys, *toValues = scratchValues;
+                for (std::size_t width = 16; width < n; width *= 2)
+                {
+                    for (std::size_t start = 0; start < n; start += 2 * width)
+                    {
+                        const std::size_t middle = std::min(start + width, n);
+                        const std::size_t end = std::min(start + 2 * width, n);
+                        if (middle == end)
+                        {
+                            std::copy(fromKeys + start, fromKeys + end, toKeys + start);
+                            if constexpr (Payload)
+                                std::copy(fromValues + start, fromValues + end, toValues + start);
+                            continue;
+                        }
+                        merge_runs<Payload>(fromKeys + start, fromValues + start, middle - start,
+                                            fromKeys + middle, fromValues + middle, end - middle,
+                                            toKeys + start, toValues + start);
+                    }
+                    std::swap(fromKeys, toKeys);
+                    std::swap(fromValues, toValues);
+                }
+
+                if (fromKeys != keys)
+                {
+                    std::copy(fromKeys, fromKeys + n, keys);
+                    if constexpr (Payload)
+                        std::copy(fromValues, fromValues + n, values);
+                }
+            }
+        }
+
+        /**
+         * Sorts keys as unsigned numbers, each values[i] travelling with keys[i]. Pass
+         * values == nullptr when there is nothing to carry, otherwise no value may have all
+         * its bits set (positions always fit). Must only be called when available() is true.
+         * @param keys, values - n keys and (optionally) n values
+         * @param allocator - used for the padded working buffers
+         */
+        template<typename Allocator>
+        void sort(std::uint64_t *keys, std::uint64_t *values, std::size_t n, const Allocator &allocator)
+        {
+            using BufferAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::int64_t>;
+            constexpr std::uint64_t SignBit = std::uint64_t(1) << 63;
+            constexpr std::uint64_t Padding = std::numeric_limits<std::uint64_t>::max();
+
+            // The kernel compares signed 64-bit lanes, so the sign bit is flipped on the way
+            // in and out, and the keys are padded with the largest key to whole blocks
+            const std::size_t padded = (n + 15) / 16 * 16;
+            const std::size_t buffers = values == nullptr ? 2 : 4;
+            std::vector<std::int64_t, BufferAllocator> buffer(padded * buffers, 0, BufferAllocator{allocator});
+            std::int64_t *workKeys = buffer.data();
+            std::int64_t *scratchKeys = workKeys + padded;
+            std::int64_t *workValues = values == nullptr ? nullptr : scratchKeys + padded;
+            std::int64_t *scratchValues = values == nullptr ? nullptr : workValues + padded;
+
+            for (std::size_t i = 0; i < padded; ++i)
+                workKeys[i] = static_cast<std::int64_t>((i < n ? keys[i] : Padding) ^ SignBit);
+
+            if (values == nullptr)
+            {
+                detail::sort<false>(workKeys, nullptr, padded, scratchKeys, nullptr);
+                for (std::size_t i = 0; i < n; ++i)
+                    keys[i] = static_cast<std::uint64_t>(workKeys[i]) ^ SignBit;
+                return;
+            }
+
+            for (std::size_t i = 0; i < padded; ++i)
+                workValues[i] = static_cast<std::int64_t>(i < n ? values[i] : Padding);
+            detail::sort<true>(workKeys, workValues, padded, scratchKeys, scratchValues);
+
+            // Padding sorts last, but may tie with real keys equal to the largest key, so it
+            // is told apart by its value
+            std::size_t out = 0;
+            for (std::size_t i = 0; i < padded && out < n; ++i)
+            {
+                const std::uint64_t key = static_cast<std::uint64_t>(workKeys[i]) ^ SignBit;
+                const std::uint64_t value = static_cast<std::uint64_t>(workValues[i]);
+                if (key == Padding && value == Padding)
+                    continue;
+                keys[out] = key;
+                values[out] = value;
+                ++out;
+            }
+        }
+#else
+        inline bool available()
+        {
+            return false;
+        }
+
+        template<typename Allocator>
+        void sort(std::uint64_t *, std::uint64_t *, std::size_t, const Allocator &)
+        {
+        }
+#endif
+    }
+}
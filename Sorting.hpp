@@ -0,0 +1,973 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "SimdSort.hpp"
+#include "ThreadPool.hpp"
+
+namespace customContainer
+    {
+    /**
+     * Maps a value to an unsigned key with the same order, so values can be sorted by
+     * the bits of their key (radix sort) instead of by comparisons. Only arithmetic types
+     * have a key, radix_key<T>::enabled tells whether T is one of them.
+     */
+    template<typename T, typename = void>
+    struct radix_key
+    {
+        static constexpr bool enabled = false;
+    };
+
+    /**
+     * Integers: unsigned values are their own key, signed values get their sign bit
+     * flipped so negative values come first.
+     */
+    template<typename T>
+    struct radix_key<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+    {
+        static constexpr bool enabled = true;
+        using Key = std::make_unsigned_t<T>;
+
+        static Key of(T value)
+        {
+            constexpr Key signBit = std::is_signed<T>::value ? Key(Key(1) << (sizeof(Key) * CHAR_BIT - 1)) : Key(0);
+            return static_cast<Key>(static_cast<Key>(value) ^ signBit);
+        }
+    };
+
+    /**
+     * IEEE floating point: positive values get their sign bit set, negative values get all
+     * their bits flipped, which turns the bit patterns into unsigned keys in value order.
+     */
+    template<typename T>
+    struct radix_key<T, std::enable_if_t<std::is_floating_point<T>::value && (sizeof(T) == 4 || sizeof(T) == 8)>>
+    {
+        static constexpr bool enabled = std::numeric_limits<T>::is_iec559;
+        using Key = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+
+        static Key of(T value)
+        {
+            constexpr Key signBit = Key(1) << (sizeof(Key) * CHAR_BIT - 1);
+            Key bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return (bits & signBit) ? Key(~bits) : Key(bits | signBit);
+        }
+    };
+
+    /// Below this many elements a comparison sort beats the fixed cost of the radix passes
+    constexpr std::size_t RadixSortMinimum = 64;
+
+    /// Up to this many elements the SIMD kernel beats the radix passes, above it the
+    /// radix sort's linear passes win
+    constexpr std::size_t SimdSortMaximum = 1024;
+
+    /**
+     * The LSD radix sort behind radix_sort(), one byte per pass. Each element becomes a
+     * (key, position) entry, so the passes stream through one contiguous array instead of
+     * chasing the elements, and passes where every key has the same byte are skipped.
+     * @tparam Position - a 32-bit index into [first, last) when it fits, which halves the
+     * entries of 32-bit keys, otherwise the element pointer itself
+     * @param keyOf - maps an element to its unsigned key, called once per element
+     */
+    template<typename Position, typename T, typename Allocator, typename KeyOf>
+    void radix_sort_entries(T **first, T **last, const Allocator &allocator, const KeyOf &keyOf)
+    {
+        using Key = decltype(keyOf(std::declval<const T &>()));
+        struct Entry
+        {
+            Key key;
+            Position position;
+        };
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using EntryAllocator = typename AllocatorTraits::template rebind_alloc<Entry>;
+        constexpr std::size_t Passes = sizeof(Key);
+
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        std::vector<Entry, EntryAllocator> entries(EntryAllocator{allocator});
+        std::vector<Entry, EntryAllocator> scratch(n, Entry(), EntryAllocator{allocator});
+        entries.reserve(n);
+
+        // One read of the elements fills the keys and the histograms of every pass
+        std::array<std::size_t, Passes * 256> counts{};
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            Key key = keyOf(*first[i]);
+            if constexpr (std::is_pointer<Position>::value)
+                entries.push_back(Entry{key, first[i]});
+            else
+                entries.push_back(Entry{key, static_cast<Position>(i)});
+            for (std::size_t pass = 0; pass < Passes; ++pass)
+                ++counts[pass * 256 + ((key >> (pass * CHAR_BIT)) & 0xFF)];
+        }
+
+        for (std::size_t pass = 0; pass < Passes; ++pass)
+        {
+            std::size_t *count = &counts[pass * 256];
+            const std::size_t shift = pass * CHAR_BIT;
+            if (count[(entries[0].key >> shift) & 0xFF] == n)
+                continue;
+
+            std::size_t offset = 0;
+            for (std::size_t digit = 0; digit < 256; ++digit)
+            {
+                std::size_t size = count[digit];
+                count[digit] = offset;
+                offset += size;
+            }
+            for (const Entry &entry : entries)
+                scratch[count[(entry.key >> shift) & 0xFF]++] = entry;
+            entries.swap(scratch);
+        }
+
+        if constexpr (std::is_pointer<Position>::value)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                first[i] = entries[i].position;
+        }
+        else
+        {
+            using PointerAllocator = typename AllocatorTraits::template rebind_alloc<T *>;
+            std::vector<T *, PointerAllocator> original(first, last, PointerAllocator{allocator});
+            for (std::size_t i = 0; i < n; ++i)
+                first[i] = original[entries[i].position];
+        }
+    }
+
+    /**
+     * Sorts element pointers by the keys keyOf gives their elements with an LSD radix sort.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the scratch buffers
+     * @param keyOf - maps an element to an unsigned key in the wanted order
+     */
+    template<typename T, typename Allocator, typename KeyOf>
+    void radix_sort(T **first, T **last, const Allocator &allocator, const KeyOf &keyOf)
+    {
+        if (static_cast<std::size_t>(last - first) <= std::numeric_limits<std::uint32_t>::max())
+            radix_sort_entries<std::uint32_t>(first, last, allocator, keyOf);
+        else
+            radix_sort_entries<T *>(first, last, allocator, keyOf);
+    }
+
+    /**
+     * Sorts element pointers by the values they point to with an LSD radix sort.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the scratch buffers
+     */
+    template<typename T, typename Allocator>
+    void radix_sort(T **first, T **last, const Allocator &allocator)
+    {
+        radix_sort(first, last, allocator, [](const T &value) { return radix_key<T>::of(value); });
+    }
+
+    /**
+     * Sorts element pointers with the AVX2 kernel of SimdSort.hpp. Keys of up to 32 bits are
+     * packed with the element's position into one 64-bit word, so only keys move; 64-bit
+     * keys (double, long) carry their position as a separate value.
+     * Must only be called when simd::available() is true and the positions fit in 32 bits.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the working buffers
+     */
+    template<typename T, typename Allocator>
+    void simd_sort(T **first, T **last, const Allocator &allocator)
+    {
+        using Key = typename radix_key<T>::Key;
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using WordAllocator = typename AllocatorTraits::template rebind_alloc<std::uint64_t>;
+        using PointerAllocator = typename AllocatorTraits::template rebind_alloc<T *>;
+
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        const std::vector<T *, PointerAllocator> original(first, last, PointerAllocator{allocator});
+        std::vector<std::uint64_t, WordAllocator> keys(n, 0, WordAllocator{allocator});
+        if constexpr (sizeof(Key) <= 4)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                keys[i] = (std::uint64_t(radix_key<T>::of(*first[i])) << 32) | i;
+            simd::sort(keys.data(), nullptr, n, allocator);
+            for (std::size_t i = 0; i < n; ++i)
+                first[i] = original[keys[i] & 0xFFFFFFFFu];
+        }
+        else
+        {
+            std::vector<std::uint64_t, WordAllocator> positions(n, 0, WordAllocator{allocator});
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                keys[i] = radix_key<T>::of(*first[i]);
+                positions[i] = i;
+            }
+            simd::sort(keys.data(), positions.data(), n, allocator);
+            for (std::size_t i = 0; i < n; ++i)
+                first[i] = original[positions[i]];
+        }
+    }
+
+    /// Largest element copied into the (value, position) entries of value_sort()
+    constexpr std::size_t ValueSortMaximumSize = 16;
+
+    /// Below this many elements they mostly fit in the caches and comparing through the
+    /// pointers is as fast as sorting the entries
+    constexpr std::size_t ValueSortMinimum = std::size_t(1) << 17;
+
+    /**
+     * Sorts element pointers with std::sort over a contiguous array of (value, position)
+     * entries instead of over the pointers, so the comparisons read neighbouring entries
+     * rather than two scattered elements each. For trivially copyable element types that
+     * have no radix key, like long double or small structs with operator<.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the entries and the copy of the input
+     */
+    template<typename T, typename Allocator>
+    void value_sort(T **first, T **last, const Allocator &allocator)
+    {
+        struct Entry
+        {
+            T value;
+            std::uint32_t position;
+        };
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using EntryAllocator = typename AllocatorTraits::template rebind_alloc<Entry>;
+        using PointerAllocator = typename AllocatorTraits::template rebind_alloc<T *>;
+
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        std::vector<Entry, EntryAllocator> entries(EntryAllocator{allocator});
+        entries.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            entries.push_back(Entry{*first[i], static_cast<std::uint32_t>(i)});
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.value < b.value; });
+
+        const std::vector<T *, PointerAllocator> original(first, last, PointerAllocator{allocator});
+        for (std::size_t i = 0; i < n; ++i)
+            first[i] = original[entries[i].position];
+    }
+
+    /**
+     * Sorts element pointers by the values they point to with a counting sort: one pass
+     * counts every key in a histogram with a bucket per possible value, a second pass drops
+     * each pointer straight into its final slot. No comparisons and no key entries, which
+     * suits types with at most 2^16 values (char, short) once the elements outnumber a
+     * fraction of the buckets.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the histogram and the copy of the input
+     */
+    template<typename T, typename Allocator>
+    void counting_sort(T **first, T **last, const Allocator &allocator)
+    {
+        using Key = typename radix_key<T>::Key;
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using CountAllocator = typename AllocatorTraits::template rebind_alloc<std::size_t>;
+        using PointerAllocator = typename AllocatorTraits::template rebind_alloc<T *>;
+        constexpr std::size_t Buckets = std::size_t(1) << (sizeof(Key) * CHAR_BIT);
+
+        std::vector<std::size_t, CountAllocator> counts(Buckets, 0, CountAllocator{allocator});
+        for (T **it = first; it != last; ++it)
+            ++counts[radix_key<T>::of(**it)];
+
+        std::size_t offset = 0;
+        for (std::size_t &count : counts)
+        {
+            std::size_t size = count;
+            count = offset;
+            offset += size;
+        }
+
+        const std::vector<T *, PointerAllocator> original(first, last, PointerAllocator{allocator});
+        for (T *element : original)
+            first[counts[radix_key<T>::of(*element)]++] = element;
+    }
+
+    /**
+     * The projection that leaves an element as it is, the default key of a container.
+     */
+    struct Identity
+    {
+        template<typename U>
+        constexpr U &&operator()(U &&value) const noexcept
+        {
+            return std::forward<U>(value);
+        }
+    };
+
+    /**
+     * Tells whether T is a std::basic_string of char with the standard traits, whose
+     * operator< compares the bytes as unsigned char, like a prefix_key() does.
+     */
+    template<typename T>
+    struct is_byte_string : std::false_type
+    {
+    };
+
+    template<typename StringAllocator>
+    struct is_byte_string<std::basic_string<char, std::char_traits<char>, StringAllocator>> : std::true_type
+    {
+    };
+
+    /**
+     * @return the 8 bytes of a string from offset on as a big-endian number, zero padded,
+     * so comparing two keys compares those bytes of the strings
+     */
+    template<typename String>
+    std::uint64_t prefix_key(const String &string, std::size_t offset = 0)
+    {
+        const std::size_t size = string.size() > offset ? std::min<std::size_t>(string.size() - offset, 8) : 0;
+        std::uint64_t key = 0;
+        for (std::size_t i = 0; i < size; ++i)
+            key |= std::uint64_t(static_cast<unsigned char>(string[offset + i])) << (56 - 8 * i);
+        return key;
+    }
+
+    /**
+     * Sorts element pointers by strings, 8 bytes at a time: a radix sort on the
+     * prefix_key() of every string puts them in order up to their 8th byte without a
+     * single string comparison, then each run of strings that share those bytes is sorted
+     * the same way on the next 8 bytes. Runs that are small, or whose strings all end
+     * within the bytes seen so far, are finished with a full comparison.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for the scratch buffers
+     * @param projection - gives the string of an element, by reference
+     */
+    template<typename T, typename Allocator, typename Projection>
+    void string_sort(T **first, T **last, const Allocator &allocator, const Projection &projection)
+    {
+        struct Run
+        {
+            T **first;
+            T **last;
+            std::size_t offset;
+        };
+        const auto text = [&projection](T *element) -> decltype(auto) { return std::invoke(projection, *element); };
+        const auto compare = [&text](T *a, T *b) { return text(a) < text(b); };
+
+        // A work list instead of recursion, so long shared prefixes can't overflow the stack
+        std::vector<Run> runs{Run{first, last, 0}};
+        while (!runs.empty())
+        {
+            const Run run = runs.back();
+            runs.pop_back();
+            if (static_cast<std::size_t>(run.last - run.first) < RadixSortMinimum)
+            {
+                std::sort(run.first, run.last, compare);
+                continue;
+            }
+            radix_sort(run.first, run.last, allocator, [&projection, &run](const T &element) {
+                return prefix_key(std::invoke(projection, element), run.offset);
+            });
+
+            const std::size_t next = run.offset + 8;
+            T **tie = run.first;
+            std::uint64_t tieKey = prefix_key(text(*tie), run.offset);
+            bool longer = text(*tie).size() > next;
+            for (T **it = run.first + 1;; ++it)
+            {
+                const std::uint64_t key = it == run.last ? 0 : prefix_key(text(*it), run.offset);
+                if (it == run.last || key != tieKey)
+                {
+                    if (it - tie > 1 && longer)
+                        runs.push_back(Run{tie, it, next});
+                    else if (it - tie > 1)
+                        std::sort(tie, it, compare);
+                    if (it == run.last)
+                        break;
+                    tie = it;
+                    tieKey = key;
+                    longer = false;
+                }
+                longer = longer || text(*it).size() > next;
+            }
+        }
+    }
+
+    /**
+     * @return true if a counting sort is the better choice for n elements of T: the key
+     * has at most 16 bits and n is large enough to pay for walking the histogram
+     */
+    template<typename T>
+    constexpr bool prefers_counting_sort(std::size_t n)
+    {
+        if constexpr (radix_key<T>::enabled)
+        {
+            using Key = typename radix_key<T>::Key;
+            if constexpr (sizeof(Key) <= 2)
+                return n >= (std::size_t(1) << (sizeof(Key) * CHAR_BIT)) / 16;
+        }
+        return false;
+    }
+
+    /**
+     * Sorts element pointers into ascending order of the values they point to. The
+     * algorithm is picked at compile time from the element type: small integers like char
+     * go through counting_sort(), the other integers, float and double through
+     * radix_sort(), std::string through string_sort(), large inputs of other small
+     * trivially copyable types through value_sort() and everything else through
+     * std::sort with operator<. Small inputs
+     * always use std::sort, and mid-sized ones go to simd_sort() when the CPU has AVX2.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for any scratch memory
+     */
+    template<typename T, typename Allocator>
+    void sort_elements(T **first, T **last, const Allocator &allocator)
+    {
+        if constexpr (radix_key<T>::enabled)
+        {
+            const std::size_t n = static_cast<std::size_t>(last - first);
+            if (n >= RadixSortMinimum)
+            {
+                if constexpr (sizeof(typename radix_key<T>::Key) <= 2)
+                {
+                    if (prefers_counting_sort<T>(n))
+                    {
+                        counting_sort(first, last, allocator);
+                        return;
+                    }
+                }
+                if (n < SimdSortMaximum && simd::available())
+                {
+                    simd_sort(first, last, allocator);
+                    return;
+                }
+                radix_sort(first, last, allocator);
+                return;
+            }
+        }
+        else if constexpr (is_byte_string<T>::value)
+        {
+            if (static_cast<std::size_t>(last - first) >= RadixSortMinimum)
+            {
+                string_sort(first, last, allocator, Identity());
+                return;
+            }
+        }
+        else if constexpr (std::is_trivially_copyable<T>::value && sizeof(T) <= ValueSortMaximumSize)
+        {
+            const std::size_t n = static_cast<std::size_t>(last - first);
+            if (n >= ValueSortMinimum && n <= std::numeric_limits<std::uint32_t>::max())
+            {
+                value_sort(first, last, allocator);
+                return;
+            }
+        }
+        std::sort(first, last, [](T *a, T *b) { return *a < *b; });
+    }
+
+    /**
+     * Tells whether a comparator on keys of type Key is operator< (Direction 1) or
+     * operator> (Direction -1), the two orders a radix sort can produce. Other comparators
+     * have Direction 0.
+     */
+    template<typename Compare, typename Key>
+    struct compare_direction : std::integral_constant<int, 0>
+    {
+    };
+
+    template<typename Key>
+    struct compare_direction<std::less<>, Key> : std::integral_constant<int, 1>
+    {
+    };
+
+    template<typename Key>
+    struct compare_direction<std::less<Key>, Key> : std::integral_constant<int, 1>
+    {
+    };
+
+    template<typename Key>
+    struct compare_direction<std::greater<>, Key> : std::integral_constant<int, -1>
+    {
+    };
+
+    template<typename Key>
+    struct compare_direction<std::greater<Key>, Key> : std::integral_constant<int, -1>
+    {
+    };
+
+    /**
+     * Sorts element pointers with std::sort over (key, position) entries, computing each
+     * key once instead of twice per comparison (decorate-sort-undecorate).
+     * @param first, last - the pointers to sort, at most 2^32 of them
+     * @param allocator - used for the entries and the copy of the input
+     * @param compare - orders two keys
+     * @param projection - computes the key of an element
+     */
+    template<typename T, typename Allocator, typename Compare, typename Projection>
+    void decorated_sort(T **first, T **last, const Allocator &allocator, const Compare &compare,
+                        const Projection &projection)
+    {
+        using Key = std::decay_t<std::invoke_result_t<const Projection &, const T &>>;
+        struct Entry
+        {
+            Key key;
+            std::uint32_t position;
+        };
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using EntryAllocator = typename AllocatorTraits::template rebind_alloc<Entry>;
+        using PointerAllocator = typename AllocatorTraits::template rebind_alloc<T *>;
+
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        std::vector<Entry, EntryAllocator> entries(EntryAllocator{allocator});
+        entries.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            entries.push_back(Entry{std::invoke(projection, *first[i]), static_cast<std::uint32_t>(i)});
+        std::sort(entries.begin(), entries.end(),
+                  [&compare](const Entry &a, const Entry &b) { return compare(a.key, b.key); });
+
+        const std::vector<T *, PointerAllocator> original(first, last, PointerAllocator{allocator});
+        for (std::size_t i = 0; i < n; ++i)
+            first[i] = original[entries[i].position];
+    }
+
+    /**
+     * Sorts element pointers into the order compare gives to the keys projection(element).
+     * The natural order (std::less on the elements themselves) goes to sort_elements().
+     * Otherwise an arithmetic key compared with std::less or std::greater is radix sorted,
+     * a string key the projection returns by reference goes through string_sort(),
+     * a key the projection computes (returns by value) is computed once per element with
+     * decorated_sort(), and a key it only reads (returns by reference) is compared in place.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for any scratch memory
+     * @param compare - orders two keys
+     * @param projection - gives the key of an element
+     */
+    template<typename T, typename Allocator, typename Compare, typename Projection>
+    void sort_projected(T **first, T **last, const Allocator &allocator, const Compare &compare,
+                        const Projection &projection)
+    {
+        using Result = std::invoke_result_t<const Projection &, const T &>;
+        using Key = std::decay_t<Result>;
+        constexpr int Direction = compare_direction<Compare, Key>::value;
+        const std::size_t n = static_cast<std::size_t>(last - first);
+
+        if constexpr (std::is_same<Projection, Identity>::value && Direction == 1)
+        {
+            sort_elements(first, last, allocator);
+        }
+        else
+        {
+            if constexpr (radix_key<Key>::enabled && Direction != 0)
+            {
+                if (n >= RadixSortMinimum)
+                {
+                    radix_sort(first, last, allocator, [&projection](const T &element) {
+                        auto key = radix_key<Key>::of(std::invoke(projection, element));
+                        return Direction == 1 ? key : decltype(key)(~key);
+                    });
+                    return;
+                }
+            }
+            if constexpr (is_byte_string<Key>::value && Direction == 1 && std::is_reference<Result>::value)
+            {
+                if (n >= RadixSortMinimum)
+                {
+                    string_sort(first, last, allocator, projection);
+                    return;
+                }
+            }
+            if constexpr (!std::is_reference<Result>::value)
+            {
+                if (n <= std::numeric_limits<std::uint32_t>::max())
+                {
+                    decorated_sort(first, last, allocator, compare, projection);
+                    return;
+                }
+            }
+            std::sort(first, last, [&](T *a, T *b) {
+                return compare(std::invoke(projection, *a), std::invoke(projection, *b));
+            });
+        }
+    }
+
+    /// From this many elements on a sort is split between threads by default
+    constexpr std::size_t ParallelSortMinimum = std::size_t(1) << 20;
+
+    /**
+     * How a container sorts its elements, see MyContainer::set_sort_options().
+     */
+    struct SortOptions
+    {
+        std::size_t parallelMinimum = ParallelSortMinimum; /// Smallest sort that is split between threads
+        unsigned threads = 0;                              /// Most threads per sort, 0 for all the hardware has
+
+        /**
+         * @return how many threads a sort of n elements should use
+         */
+        unsigned threads_for(std::size_t n) const
+        {
+            if (n < parallelMinimum || n < 2)
+                return 1;
+            return threads == 0 ? ThreadPool::hardware_threads() : threads;
+        }
+    };
+
+    /**
+     * Sorts element pointers on several threads of ThreadPool::shared(): every thread sorts
+     * one slice with sort_elements(), then the sorted slices are merged pairwise. Each merge
+     * is cut into independent pieces along its merge path, so all the threads keep working
+     * up to the last merge. The scratch memory comes from std::allocator, because the
+     * container's allocator (a PoolAllocator, a pmr arena) need not be thread safe.
+     * compare and projection are called from all the threads at once.
+     * @param first, last - the pointers to sort
+     * @param threads - how many threads to use, at least 2
+     * @param compare, projection - the order, see sort_projected()
+     */
+    template<typename T, typename Compare = std::less<>, typename Projection = Identity>
+    void parallel_sort(T **first, T **last, unsigned threads, const Compare &compare = Compare(),
+                       const Projection &projection = Projection())
+    {
+        const auto less = [&](T *a, T *b) { return compare(std::invoke(projection, *a), std::invoke(projection, *b)); };
+        const std::size_t n = static_cast<std::size_t>(last - first);
+        ThreadPool &pool = ThreadPool::shared();
+
+        std::vector<std::size_t> bounds;
+        for (std::size_t slice = 0; slice <= threads; ++slice)
+            bounds.push_back(n * slice / threads);
+        pool.run(threads, threads, [&](std::size_t slice) {
+            sort_projected(first + bounds[slice], first + bounds[slice + 1], std::allocator<T *>(), compare, projection);
+        });
+
+        std::vector<T *> scratch(n);
+        T **from = first;
+        T **to = scratch.data();
+        while (bounds.size() > 2)
+        {
+            // Run r of this round is [bounds[r], bounds[r + 1]), merged with run r + 1
+            const std::size_t runs = bounds.size() - 1;
+            const std::size_t pairs = runs / 2;
+            const std::size_t pieces = std::max<std::size_t>(1, threads / pairs);
+            pool.run(pairs * pieces + runs % 2, threads, [&](std::size_t task) {
+                if (task == pairs * pieces)
+                {
+                    // The odd run out is carried over to the next round as it is
+                    std::copy(from + bounds[runs - 1], from + n, to + bounds[runs - 1]);
+                    return;
+                }
+                const std::size_t pair = task / pieces;
+                const std::size_t piece = task % pieces;
+                T **a = from + bounds[2 * pair];
+                T **b = from + bounds[2 * pair + 1];
+                const std::size_t aSize = bounds[2 * pair + 1] - bounds[2 * pair];
+                const std::size_t bSize = bounds[2 * pair + 2] - bounds[2 * pair + 1];
+
+                // The i elements of a and j elements of b that come before output position d
+                const auto split = [&](std::size_t d) {
+                    std::size_t low = d > bSize ? d - bSize : 0;
+                    std::size_t high = std::min(d, aSize);
+                    while (low < high)
+                    {
+                        std::size_t middle = low + (high - low) / 2;
+                        if (less(b[d - middle - 1], a[middle]))
+                            high = middle;
+                        else
+                            low = middle + 1;
+                    }
+                    return low;
+                };
+                const std::size_t begin = (aSize + bSize) * piece / pieces;
+                const std::size_t end = (aSize + bSize) * (piece + 1) / pieces;
+                const std::size_t aBegin = split(begin);
+                const std::size_t aEnd = split(end);
+                std::merge(a + aBegin, a + aEnd, b + (begin - aBegin), b + (end - aEnd),
+                           to + bounds[2 * pair] + begin, less);
+            });
+
+            std::vector<std::size_t> merged;
+            for (std::size_t run = 0; run < runs; run += 2)
+                merged.push_back(bounds[run]);
+            merged.push_back(n);
+            bounds.swap(merged);
+            std::swap(from, to);
+        }
+
+        if (from != first)
+            std::copy(from, from + n, first);
+    }
+
+    /**
+     * Sorts element pointers like sort_projected(), on several threads when options ask for
+     * it at this size.
+     * @param first, last - the pointers to sort
+     * @param allocator - used for any scratch memory of a single-threaded sort
+     * @param options - when and how wide to split the sort
+     * @param compare, projection - the order, by default ascending values
+     */
+    template<typename T, typename Allocator, typename Compare = std::less<>, typename Projection = Identity>
+    void sort_elements(T **first, T **last, const Allocator &allocator, const SortOptions &options,
+                       const Compare &compare = Compare(), const Projection &projection = Projection())
+    {
+        const unsigned threads = options.threads_for(static_cast<std::size_t>(last - first));
+        if (threads > 1)
+            parallel_sort(first, last, threads, compare, projection);
+        else
+            sort_projected(first, last, allocator, compare, projection);
+    }
+
+    /// Below this many elements a LazySort sorts everything up front
+    constexpr std::size_t LazySortMinimum = 4096;
+
+    /// Segments of at most this many elements are sorted outright instead of partitioned
+    constexpr std::size_t LazySortChunk = 256;
+
+    /// A LazySort sorts all that is left once this fraction (1/16) of it is settled
+    constexpr std::size_t LazySortFinishShare = 16;
+
+    /// ... or once its partitions have read the elements this many times over
+    constexpr std::size_t LazySortPartitionPasses = 4;
+
+    /**
+     * A sorted permutation of element pointers that is only sorted as far as it is read.
+     * Every position starts unsettled. Reading position i partitions the segment around i
+     * (an incremental quickselect) until i sits in a segment of at most LazySortChunk
+     * elements, which is then sorted, so reading the first k positions costs about
+     * O(n + k log k) instead of O(n log n). Each pivot is picked from a sample so that
+     * the part holding i shrinks to about i's share plus 1/16 of the segment, which keeps
+     * reading from either end close to one pass over the elements.
+     * Once 1/16 of the positions are sorted, or the partitions have read the elements 4
+     * times over (few distinct values), the rest is sorted with sort_elements(), one
+     * segment at a time, so walking the whole order costs a full sort plus a few passes.
+     * Types that are counting sorted (char, short) skip all this and are sorted up front,
+     * since one counting pass is cheaper than the first partition.
+     * A key the projection computes (returns by value) is computed once per element up
+     * front and kept next to the pointer, like decorated_sort() does, so the partitions
+     * and sorts only compare stored keys.
+     * at() may be called from several threads at once; until everything is sorted they
+     * take turns under a lock, after that they only read.
+     * @tparam Allocator - allocates the pointer list and the boundary bits
+     */
+    template<typename T, typename Allocator, typename Compare, typename Projection>
+    class LazySort
+    {
+    private:
+        using List = std::vector<T *, Allocator>;
+        using BitAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<bool>;
+        using Key = std::decay_t<std::invoke_result_t<const Projection &, const T &>>;
+
+        static constexpr bool Decorated = !std::is_reference<std::invoke_result_t<const Projection &, const T &>>::value;
+        static constexpr std::size_t SampleSize = 64;
+
+        /// A pointer with its computed key, the item of a decorated sort
+        struct Entry
+        {
+            Key key;
+            T *element;
+        };
+        using Item = std::conditional_t<Decorated, Entry, T *>;
+        using Items = std::vector<Item, typename std::allocator_traits<Allocator>::template rebind_alloc<Item>>;
+
+        Items items;                              /// The permutation, with the keys when Decorated
+        std::vector<bool, BitAllocator> boundary; /// boundary[j]: all before j come before all from j on
+        std::size_t settledCount;                 /// Positions settled by sorting a segment
+        std::size_t partitioned;                  /// Elements visited by the partitions so far
+        std::atomic<bool> complete;               /// Everything is sorted, at() only reads
+        std::mutex sorting;                       /// Held while at() sorts, so iterators can read from any thread
+        SortOptions options;
+        Compare compare;
+        Projection projection;
+
+        static T *element_of(T *item) { return item; }
+        static T *element_of(const Entry &entry) { return entry.element; }
+
+        decltype(auto) key_of(T *item) const { return std::invoke(projection, *item); }
+        const Key &key_of(const Entry &entry) const { return entry.key; }
+
+        bool less(const Item &a, const Item &b) const
+        {
+            return compare(key_of(a), key_of(b));
+        }
+
+        /// Sorts [lo, hi) outright and marks every position in it as settled
+        void sort_segment(std::size_t lo, std::size_t hi)
+        {
+            if constexpr (Decorated)
+                std::sort(items.begin() + lo, items.begin() + hi,
+                          [this](const Entry &a, const Entry &b) { return less(a, b); });
+            else
+                sort_elements(items.data() + lo, items.data() + hi, items.get_allocator(), options, compare,
+                              projection);
+            for (std::size_t j = lo; j <= hi; ++j)
+                boundary[j] = true;
+            settledCount += hi - lo;
+        }
+
+        /**
+         * Picks a pivot for segment [lo, hi) so that position i is likely to end up in a
+         * part much smaller than the segment: a sample of evenly spaced elements is put in
+         * order and the pivot is taken a little past i's share of it, towards the middle.
+         * @return a copy of the pivot item, which the partition may move
+         */
+        Item pivot(std::size_t lo, std::size_t hi, std::size_t i) const
+        {
+            const std::size_t m = hi - lo;
+            std::array<std::size_t, SampleSize> sample;
+            for (std::size_t j = 0; j < SampleSize; ++j)
+                sample[j] = lo + j * m / SampleSize + m / (2 * SampleSize);
+
+            constexpr std::size_t Margin = SampleSize / LazySortFinishShare;
+            const std::size_t share = (i - lo) * SampleSize / m;
+            const std::size_t rank = 2 * (i - lo) < m ? std::min(share + Margin, SampleSize - 1)
+                                                      : (share > Margin ? share - Margin : 0);
+            std::nth_element(sample.begin(), sample.begin() + rank, sample.end(),
+                             [this](std::size_t a, std::size_t b) { return less(items[a], items[b]); });
+            return items[sample[rank]];
+        }
+
+        /// Partitions the segment holding position i until i is settled
+        void settle(std::size_t i)
+        {
+            std::size_t lo = i;
+            while (!boundary[lo])
+                --lo;
+            std::size_t hi = i + 1;
+            while (!boundary[hi])
+                ++hi;
+
+            while (hi - lo > LazySortChunk)
+            {
+                const Item p = pivot(lo, hi, i);
+                auto first = items.begin() + lo;
+                auto last = items.begin() + hi;
+                auto middle = std::partition(first, last, [&](const Item &item) { return less(item, p); });
+                partitioned += hi - lo;
+                if (middle == first)
+                {
+                    // p is the smallest of the segment, its equals are settled as one run
+                    middle = std::partition(first, last, [&](const Item &item) { return !less(p, item); });
+                    partitioned += hi - lo;
+                    const std::size_t equalEnd = lo + static_cast<std::size_t>(middle - first);
+                    for (std::size_t j = lo; j <= equalEnd; ++j)
+                        boundary[j] = true;
+                    if (i < equalEnd)
+                        return;
+                    lo = equalEnd;
+                    continue;
+                }
+
+                const std::size_t split = lo + static_cast<std::size_t>(middle - first);
+                boundary[split] = true;
+                if (i < split)
+                    hi = split;
+                else
+                    lo = split;
+            }
+            sort_segment(lo, hi);
+        }
+
+        /// Sorts every segment that is not sorted yet, with sorting held
+        void sort_rest()
+        {
+            if (complete.load(std::memory_order_relaxed))
+                return;
+            for (std::size_t lo = 0; lo < items.size();)
+            {
+                std::size_t hi = lo + 1;
+                while (!boundary[hi])
+                    ++hi;
+                if (hi - lo > 1)
+                    sort_segment(lo, hi);
+                lo = hi;
+            }
+            complete.store(true, std::memory_order_release);
+        }
+
+        /**
+         * @return true if sort_elements() sorts n elements in about one pass (a counting
+         * sort), which is cheaper than the partitions of even a short lazy read
+         */
+        static constexpr bool sorts_in_one_pass(std::size_t n)
+        {
+            if constexpr (std::is_same<Projection, Identity>::value && compare_direction<Compare, T>::value == 1)
+                return prefers_counting_sort<T>(n);
+            return false;
+        }
+
+        /// Takes the pointers as they are, or decorates them with their keys
+        static Items make_items(List &&elements, const Projection &projection)
+        {
+            if constexpr (Decorated)
+            {
+                Items items{typename Items::allocator_type(elements.get_allocator())};
+                items.reserve(elements.size());
+                for (T *element : elements)
+                    items.push_back(Entry{std::invoke(projection, *element), element});
+                return items;
+            }
+            else
+            {
+                return std::move(elements);
+            }
+        }
+
+    public:
+        /**
+         * Takes the elements to sort; small lists, and lists a counting sort handles in
+         * one pass, are sorted right away.
+         * @param elements - pointers to the elements, in any order
+         * @param options - how to sort what is sorted outright
+         * @param compare, projection - the order
+         */
+        LazySort(List &&elements, const SortOptions &options, const Compare &compare, const Projection &projection)
+            : items(make_items(std::move(elements), projection)),
+              boundary(items.size() + 1, false, BitAllocator(items.get_allocator())),
+              settledCount(0), partitioned(0), complete(false), options(options), compare(compare),
+              projection(projection)
+        {
+            boundary.front() = true;
+            boundary.back() = true;
+            if (items.size() < LazySortMinimum || sorts_in_one_pass(items.size()))
+                sort_rest();
+        }
+
+        /**
+         * @return the element at position i of the sorted order, sorting as far as needed.
+         * Safe to call from several threads at once: until the order is complete the
+         * sorting, and the read with it, happen under a lock.
+         */
+        T *at(std::size_t i)
+        {
+            if (complete.load(std::memory_order_acquire))
+                return element_of(items[i]);
+
+            std::lock_guard<std::mutex> lock(sorting);
+            if (!complete.load(std::memory_order_relaxed) && !(boundary[i] && boundary[i + 1]))
+            {
+                settle(i);
+                if (settledCount * LazySortFinishShare >= items.size() ||
+                    partitioned >= LazySortPartitionPasses * items.size())
+                    sort_rest();
+            }
+            return element_of(items[i]);
+        }
+
+        /**
+         * Sorts every segment that is not sorted yet, after which at() only reads.
+         */
+        void finish()
+        {
+            std::lock_guard<std::mutex> lock(sorting);
+            sort_rest();
+        }
+
+        /**
+         * @return true if the whole order is sorted
+         */
+        bool sorted() const
+        {
+            return complete.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @return the number of elements
+         */
+        std::size_t size() const
+        {
+            return items.size();
+        }
+    };
+}
@@ -0,0 +1,1069 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include "PoolAllocator.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace customContainer
+    {
+    /**
+     * Calls release when it goes out of scope unless dismissed. Storages use it to give back
+     * a block whose element failed to construct, which works the same with exceptions
+     * disabled, where no try/catch may appear.
+     */
+    template<typename Release>
+    class BlockGuard
+    {
+    private:
+        Release release;
+        bool armed;
+
+    public:
+        explicit BlockGuard(Release release) : release(release), armed(true)
+        {
+        }
+
+        BlockGuard(const BlockGuard &) = delete;
+        BlockGuard &operator=(const BlockGuard &) = delete;
+
+        ~BlockGuard()
+        {
+            if (armed)
+                release();
+        }
+
+        /// The block is in use, keep it
+        void dismiss()
+        {
+            armed = false;
+        }
+    };
+
+    /**
+     * Blocks (nodes or chunks) reserved ahead of time in one allocation, a slab. A storage
+     * takes blocks from the newest slab before asking its allocator for single blocks, and
+     * gives them back here when they are freed. A slab goes back to the allocator once all
+     * the blocks taken from it were given back and no more blocks will be taken from it.
+     */
+    template<typename Block, typename BlockAllocator>
+    class BlockReserve
+    {
+    private:
+        using Traits = std::allocator_traits<BlockAllocator>;
+
+        struct Slab
+        {
+            Block *base;
+            std::size_t capacity;
+            std::size_t used;  /// Blocks taken so far, only updated once the slab is retired
+            std::size_t freed; /// Blocks given back
+        };
+
+        using SlabIterator = typename std::vector<Slab>::iterator;
+
+        std::vector<Slab> slabs; /// Sorted by address, so a block's slab is a binary search away
+        Block *currentBase;                     /// The slab blocks are taken from, nullptr if none
+        Block *next;                            /// Next block to take from the current slab
+        Block *end;                             /// End of the current slab
+
+        SlabIterator find(Block *block)
+        {
+            std::less<Block *> before;
+            auto it = std::upper_bound(slabs.begin(), slabs.end(), block,
+                                       [&before](Block *b, const Slab &slab) { return before(b, slab.base); });
+            if (it == slabs.begin())
+                return slabs.end();
+            --it;
+            return before(block, it->base + it->capacity) ? it : slabs.end();
+        }
+
+        /// Stops taking blocks from the current slab and frees it if nothing of it is in use
+        void retire_current(BlockAllocator &allocator)
+        {
+            if (currentBase == nullptr)
+                return;
+
+            SlabIterator it = find(currentBase);
+            it->used = static_cast<std::size_t>(next - currentBase);
+            currentBase = next = end = nullptr;
+            if (it->freed == it->used)
+            {
+                Traits::deallocate(allocator, it->base, it->capacity);
+                slabs.erase(it);
+            }
+        }
+
+    public:
+        BlockReserve() : currentBase(nullptr), next(nullptr), end(nullptr)
+        {
+        }
+
+        /**
+         * @return how many blocks can still be taken without allocating
+         */
+        std::size_t spare() const
+        {
+            return static_cast<std::size_t>(end - next);
+        }
+
+        /**
+         * Makes sure at least n blocks can be taken, allocating them as one slab if needed.
+         */
+        void reserve(BlockAllocator &allocator, std::size_t n)
+        {
+            if (n <= spare())
+                return;
+
+            Block *base = Traits::allocate(allocator, n);
+            retire_current(allocator);
+            std::less<Block *> before;
+            auto at = std::upper_bound(slabs.begin(), slabs.end(), base,
+                                       [&before](Block *b, const Slab &slab) { return before(b, slab.base); });
+            slabs.insert(at, Slab{base, n, 0, 0});
+            currentBase = next = base;
+            end = base + n;
+        }
+
+        /**
+         * @return uninitialized memory for one block, or nullptr if nothing is reserved
+         */
+        Block *take()
+        {
+            return next == end ? nullptr : next++;
+        }
+
+        /**
+         * Gives a block back if it came from one of the slabs.
+         * @return false if the block is not from a slab and must be deallocated by the caller
+         */
+        bool give_back(BlockAllocator &allocator, Block *block)
+        {
+            if (slabs.empty())
+                return false;
+
+            SlabIterator it = find(block);
+            if (it == slabs.end())
+                return false;
+
+            ++it->freed;
+            if (it->base != currentBase && it->freed == it->used)
+            {
+                Traits::deallocate(allocator, it->base, it->capacity);
+                slabs.erase(it);
+            }
+            return true;
+        }
+
+        /**
+         * Frees every slab, whatever is still in use. Called by the owning storage last.
+         */
+        void release(BlockAllocator &allocator)
+        {
+            for (const Slab &slab : slabs)
+                Traits::deallocate(allocator, slab.base, slab.capacity);
+            slabs.clear();
+            currentBase = next = end = nullptr;
+        }
+    };
+
+    /**
+     * Storage policy that keeps every element in its own heap node, doubly linked in insertion
+     * order. Adding never moves the existing elements, so a pointer (or cursor) to an element
+     * stays valid until that element is removed, and a known element is unlinked in constant
+     * time. The nodes come from Allocator rebound to the node type.
+     */
+    template<typename T, typename Allocator = std::allocator<T>>
+    class LinkedStorage
+    {
+    private:
+        struct Node
+        {
+            T data;
+            Node *prev;
+            Node *next;
+
+            /// Constructs the element in place from the arguments given to emplace_back()
+            template<typename... Args>
+            explicit Node(std::in_place_t, Args &&...args)
+                : data(std::forward<Args>(args)...), prev(nullptr), next(nullptr)
+            {
+            }
+        };
+
+        using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+        using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+        NodeAllocator nodeAllocator;
+        BlockReserve<Node, NodeAllocator> reserved; /// Nodes allocated ahead by reserve()
+        Node *head;
+        Node *tail;        /// Last node, so emplace_back() doesn't have to walk the list
+        std::size_t count; /// Number of nodes currently linked
+
+    public:
+        /// Cursors stay valid until their element is removed, so they can be kept aside
+        static constexpr bool stable_cursors = true;
+
+        /// at(i) walks the list, so a jump costs as many steps as it skips
+        static constexpr bool random_access = false;
+
+        /**
+         * A position in insertion order, the end position holds nullptr.
+         */
+        class Cursor
+        {
+        private:
+            friend class LinkedStorage;
+            Node *node;
+
+        public:
+            explicit Cursor(Node *node = nullptr) : node(node)
+            {
+            }
+
+            T &operator*() const
+            {
+                return node->data;
+            }
+
+            Cursor &operator++()
+            {
+                node = node->next;
+                return *this;
+            }
+
+            bool operator==(const Cursor &other) const
+            {
+                return node == other.node;
+            }
+
+            bool operator!=(const Cursor &other) const
+            {
+                return !(*this == other);
+            }
+        };
+
+        explicit LinkedStorage(const Allocator &allocator = Allocator())
+            : nodeAllocator(allocator), head(nullptr), tail(nullptr), count(0)
+        {
+        }
+
+        LinkedStorage(const LinkedStorage &other)
+            : LinkedStorage(Allocator(NodeTraits::select_on_container_copy_construction(other.nodeAllocator)))
+        {
+            reserve(other.count);
+            for (Node *temp = other.head; temp != nullptr; temp = temp->next)
+                emplace_back(temp->data);
+        }
+
+        /**
+         * Copies other's elements. The allocator is taken from other only when it
+         * propagates on copy assignment; otherwise (std::pmr) this storage keeps its own
+         * and the copy is made with it.
+         */
+        LinkedStorage &operator=(const LinkedStorage &other)
+        {
+            if (this != &other)
+            {
+                constexpr bool propagate = NodeTraits::propagate_on_container_copy_assignment::value;
+                LinkedStorage copy(Allocator(propagate ? other.nodeAllocator : nodeAllocator));
+                copy.reserve(other.count);
+                for (Node *temp = other.head; temp != nullptr; temp = temp->next)
+                    copy.emplace_back(temp->data);
+
+                // The nodes move together with the allocator that made them
+                if constexpr (propagate)
+                    std::swap(nodeAllocator, copy.nodeAllocator);
+                swap_blocks(copy);
+            }
+            return *this;
+        }
+
+        /**
+         * Takes over other's nodes, leaving other empty.
+         */
+        LinkedStorage(LinkedStorage &&other) noexcept
+            : LinkedStorage(Allocator(other.nodeAllocator))
+        {
+            swap_blocks(other);
+        }
+
+        /**
+         * Takes over other's nodes when the allocator propagates on move assignment or both
+         * allocators are equal. Otherwise the nodes must stay with other's allocator, so the
+         * elements are moved one by one into nodes of this storage's allocator.
+         */
+        LinkedStorage &operator=(LinkedStorage &&other)
+        {
+            if (this == &other)
+                return *this;
+
+            constexpr bool propagate = NodeTraits::propagate_on_container_move_assignment::value;
+            if (propagate || nodeAllocator == other.nodeAllocator)
+            {
+                LinkedStorage taken(std::move(other));
+                if constexpr (propagate)
+                    std::swap(nodeAllocator, taken.nodeAllocator);
+                swap_blocks(taken);
+            }
+            else
+            {
+                LinkedStorage moved{Allocator(nodeAllocator)};
+                moved.reserve(other.count);
+                for (Cursor pos = other.begin(); pos != other.end(); ++pos)
+                    moved.emplace_back(std::move(*pos));
+                swap_blocks(moved);
+                other.clear();
+            }
+            return *this;
+        }
+
+        /**
+         * When the allocator frees all its blocks at once (a NodePool nobody else uses) and
+         * the elements need no destructor, the nodes are left to the pool instead of walked.
+         */
+        ~LinkedStorage()
+        {
+            if (!(std::is_trivially_destructible<T>::value && releases_in_bulk(nodeAllocator)))
+                clear();
+            reserved.release(nodeAllocator);
+        }
+
+        /**
+         * @return a copy of the allocator used for the elements
+         */
+        Allocator get_allocator() const
+        {
+            return Allocator(nodeAllocator);
+        }
+
+        Cursor begin() { return Cursor(head); }
+        Cursor end() { return Cursor(nullptr); }
+        Cursor last() { return Cursor(tail); }
+
+        /**
+         * @return the position before position in insertion order, end() before the first
+         */
+        Cursor before(Cursor position) { return Cursor(position.node->prev); }
+
+        /**
+         * @return the position of the i-th element in insertion order (i < size()), walked
+         * to from the nearer end of the list
+         */
+        Cursor at(std::size_t i)
+        {
+            Node *node;
+            if (i < count / 2)
+            {
+                for (node = head; i > 0; --i)
+                    node = node->next;
+            }
+            else
+            {
+                node = tail;
+                for (std::size_t back = count - 1 - i; back > 0; --back)
+                    node = node->prev;
+            }
+            return Cursor(node);
+        }
+
+        /**
+         * Calls visit on every element in insertion order, without allowing changes.
+         * @param visit - callable taking a const T&
+         */
+        template<typename Visitor>
+        void for_each(Visitor visit) const
+        {
+            for (Node *temp = head; temp != nullptr; temp = temp->next)
+                visit(temp->data);
+        }
+
+        /**
+         * @return the number of stored elements
+         */
+        std::size_t size() const
+        {
+            return count;
+        }
+
+        /**
+         * Constructs a new element from args inside a new node after the last element.
+         * @param args - the constructor arguments of the element
+         * @return the new element
+         */
+        template<typename... Args>
+        T &emplace_back(Args &&...args)
+        {
+            Node *node = create_node(std::forward<Args>(args)...);
+            node->prev = tail;
+            if (tail == nullptr)
+                head = node;
+            else
+                tail->next = node;
+
+            tail = node;
+            ++count;
+            return node->data;
+        }
+
+        /**
+         * Allocates the nodes for the elements still missing to reach n in one slab, so the
+         * following adds take their nodes from it instead of allocating one by one.
+         * @param n - the number of elements to make room for
+         */
+        void reserve(std::size_t n)
+        {
+            if (n > count)
+                reserved.reserve(nodeAllocator, n - count);
+        }
+
+        /**
+         * Appends the elements of [first, last) in order. When the range size is known up
+         * front all the nodes come from a single allocation.
+         * @return how many elements were appended
+         */
+        template<typename InputIt>
+        std::size_t append_range(InputIt first, InputIt last)
+        {
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value)
+                reserve(count + static_cast<std::size_t>(std::distance(first, last)));
+
+            std::size_t appended = 0;
+            for (; first != last; ++first, ++appended)
+                emplace_back(*first);
+            return appended;
+        }
+
+        /**
+         * Removes every element matching the predicate while keeping the others in order.
+         * @param pred - callable taking a const T& and returning true for elements to remove
+         * @return how many elements were removed
+         */
+        template<typename Predicate>
+        std::size_t erase_if(Predicate pred)
+        {
+            std::size_t removed = 0;
+            Node *cur = head;
+            while (cur != nullptr)
+            {
+                Node *next = cur->next;
+                if (pred(cur->data))
+                {
+                    unlink(cur);
+                    destroy_node(cur);
+                    ++removed;
+                }
+                cur = next;
+            }
+            return removed;
+        }
+
+        /**
+         * Removes the element at position without walking the list.
+         * @param position - a cursor at an element of this storage, not end()
+         */
+        void erase(Cursor position)
+        {
+            unlink(position.node);
+            destroy_node(position.node);
+        }
+
+        /**
+         * Deletes every node.
+         */
+        void clear()
+        {
+            while (head != nullptr)
+            {
+                Node *toDel = head;
+                head = head->next;
+                destroy_node(toDel);
+            }
+            tail = nullptr;
+            count = 0;
+        }
+
+    private:
+        void unlink(Node *node)
+        {
+            if (node->prev == nullptr)
+                head = node->next;
+            else
+                node->prev->next = node->next;
+
+            if (node->next == nullptr)
+                tail = node->prev;
+            else
+                node->next->prev = node->prev;
+            --count;
+        }
+
+        template<typename... Args>
+        Node *create_node(Args &&...args)
+        {
+            Node *node = reserved.take();
+            if (node == nullptr)
+                node = NodeTraits::allocate(nodeAllocator, 1);
+            BlockGuard guard([this, node] { free_node(node); });
+            NodeTraits::construct(nodeAllocator, node, std::in_place, std::forward<Args>(args)...);
+            guard.dismiss();
+            return node;
+        }
+
+        void destroy_node(Node *node)
+        {
+            NodeTraits::destroy(nodeAllocator, node);
+            free_node(node);
+        }
+
+        void free_node(Node *node)
+        {
+            if (!reserved.give_back(nodeAllocator, node))
+                NodeTraits::deallocate(nodeAllocator, node, 1);
+        }
+
+        /// Exchanges the nodes (and the reserve they came from), not the allocators
+        void swap_blocks(LinkedStorage &other) noexcept
+        {
+            std::swap(reserved, other.reserved);
+            std::swap(head, other.head);
+            std::swap(tail, other.tail);
+            std::swap(count, other.count);
+        }
+    };
+
+    /**
+     * Storage policy that keeps the elements next to each other in one growable buffer.
+     * Iteration and sorting touch consecutive memory, but adding may move the elements,
+     * so pointers to them are only valid until the next change.
+     */
+    template<typename T, typename Allocator = std::allocator<T>>
+    class ContiguousStorage
+    {
+    private:
+        std::vector<T, Allocator> elements;
+
+    public:
+        explicit ContiguousStorage(const Allocator &allocator = Allocator()) : elements(allocator)
+        {
+        }
+
+        /**
+         * @return a copy of the allocator used for the buffer
+         */
+        Allocator get_allocator() const
+        {
+            return elements.get_allocator();
+        }
+
+        /// A position in insertion order is simply a pointer into the buffer
+        using Cursor = T *;
+
+        /// Removing shifts the elements behind and adding may reallocate, cursors don't last
+        static constexpr bool stable_cursors = false;
+
+        /// at(i) is a pointer addition
+        static constexpr bool random_access = true;
+
+        Cursor begin() { return elements.data(); }
+        Cursor end() { return elements.data() + elements.size(); }
+        Cursor last() { return elements.empty() ? end() : end() - 1; }
+
+        /**
+         * @return the position before position in insertion order, end() before the first
+         */
+        Cursor before(Cursor position) { return position == begin() ? end() : position - 1; }
+
+        /**
+         * @return the position of the i-th element in insertion order (i < size())
+         */
+        Cursor at(std::size_t i) { return begin() + i; }
+
+        /**
+         * Calls visit on every element in insertion order, without allowing changes.
+         * @param visit - callable taking a const T&
+         */
+        template<typename Visitor>
+        void for_each(Visitor visit) const
+        {
+            for (const T &element : elements)
+                visit(element);
+        }
+
+        /**
+         * @return the number of stored elements
+         */
+        std::size_t size() const
+        {
+            return elements.size();
+        }
+
+        /**
+         * Constructs a new element from args after the last element.
+         * @param args - the constructor arguments of the element
+         * @return the new element
+         */
+        template<typename... Args>
+        T &emplace_back(Args &&...args)
+        {
+            return elements.emplace_back(std::forward<Args>(args)...);
+        }
+
+        /**
+         * Grows the buffer once so it can hold n elements.
+         * @param n - the number of elements to make room for
+         */
+        void reserve(std::size_t n)
+        {
+            elements.reserve(n);
+        }
+
+        /**
+         * Appends the elements of [first, last) in order, growing the buffer at most once
+         * when the range size is known up front.
+         * @return how many elements were appended
+         */
+        template<typename InputIt>
+        std::size_t append_range(InputIt first, InputIt last)
+        {
+            std::size_t before = elements.size();
+            elements.insert(elements.end(), first, last);
+            return elements.size() - before;
+        }
+
+        /**
+         * Removes every element matching the predicate while keeping the others in order.
+         * @param pred - callable taking a const T& and returning true for elements to remove
+         * @return how many elements were removed
+         */
+        template<typename Predicate>
+        std::size_t erase_if(Predicate pred)
+        {
+            auto newEnd = std::remove_if(elements.begin(), elements.end(), pred);
+            std::size_t removed = static_cast<std::size_t>(elements.end() - newEnd);
+            elements.erase(newEnd, elements.end());
+            return removed;
+        }
+
+        /**
+         * Removes every element.
+         */
+        void clear()
+        {
+            elements.clear();
+        }
+    };
+
+    /**
+     * Storage policy that links fixed-size chunks of elements instead of single elements
+     * (an unrolled linked list). Each chunk holds about one cache line of elements, so small
+     * types like char need one allocation and one pointer per chunk rather than per element.
+     * Elements never move on add, and are only shifted inside their chunk on remove.
+     * The chunks come from Allocator rebound to the chunk type.
+     */
+    template<typename T, typename Allocator = std::allocator<T>>
+    class UnrolledStorage
+    {
+    public:
+        /// Elements per chunk: a cache line's worth, but at least 4 for large types
+        static constexpr std::size_t ChunkCapacity = sizeof(T) >= 16 ? 4 : 64 / sizeof(T);
+
+    private:
+        struct Chunk
+        {
+            Chunk *prev;      /// Lets the reverse orders step back a chunk
+            Chunk *next;
+            std::size_t used; /// Constructed elements, always in slots [0, used)
+            alignas(T) unsigned char slots[ChunkCapacity * sizeof(T)];
+
+            Chunk() : prev(nullptr), next(nullptr), used(0)
+            {
+            }
+
+            T *at(std::size_t i)
+            {
+                return std::launder(reinterpret_cast<T *>(slots)) + i;
+            }
+
+            const T *at(std::size_t i) const
+            {
+                return std::launder(reinterpret_cast<const T *>(slots)) + i;
+            }
+        };
+
+        using ChunkAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Chunk>;
+        using ChunkTraits = std::allocator_traits<ChunkAllocator>;
+
+        ChunkAllocator chunkAllocator;
+        BlockReserve<Chunk, ChunkAllocator> reserved; /// Chunks allocated ahead by reserve()
+        Chunk *head;
+        Chunk *tail;       /// Only the last chunk may receive new elements
+        std::size_t count; /// Number of elements over all chunks
+
+    public:
+        /// Removing compacts chunks, so cursors behind a removed element move
+        static constexpr bool stable_cursors = false;
+
+        /// at(i) walks the chunks
+        static constexpr bool random_access = false;
+
+        /**
+         * A position in insertion order: a chunk and a slot inside it, the end position
+         * has no chunk. Chunks are never left empty, so slot 0 of a chunk always exists.
+         */
+        class Cursor
+        {
+        private:
+            friend class UnrolledStorage;
+            Chunk *chunk;
+            std::size_t slot;
+
+        public:
+            explicit Cursor(Chunk *chunk = nullptr, std::size_t slot = 0) : chunk(chunk), slot(slot)
+            {
+            }
+
+            T &operator*() const
+            {
+                return *chunk->at(slot);
+            }
+
+            Cursor &operator++()
+            {
+                if (++slot == chunk->used)
+                {
+                    chunk = chunk->next;
+                    slot = 0;
+                }
+                return *this;
+            }
+
+            bool operator==(const Cursor &other) const
+            {
+                return chunk == other.chunk && slot == other.slot;
+            }
+
+            bool operator!=(const Cursor &other) const
+            {
+                return !(*this == other);
+            }
+        };
+
+        explicit UnrolledStorage(const Allocator &allocator = Allocator())
+            : chunkAllocator(allocator), head(nullptr), tail(nullptr), count(0)
+        {
+        }
+
+        UnrolledStorage(const UnrolledStorage &other)
+            : UnrolledStorage(Allocator(ChunkTraits::select_on_container_copy_construction(other.chunkAllocator)))
+        {
+            reserve(other.count);
+            other.for_each([this](const T &data) { emplace_back(data); });
+        }
+
+        /**
+         * Copies other's elements, keeping this storage's allocator unless it propagates on
+         * copy assignment, like LinkedStorage.
+         */
+        UnrolledStorage &operator=(const UnrolledStorage &other)
+        {
+            if (this != &other)
+            {
+                constexpr bool propagate = ChunkTraits::propagate_on_container_copy_assignment::value;
+                UnrolledStorage copy(Allocator(propagate ? other.chunkAllocator : chunkAllocator));
+                copy.reserve(other.count);
+                other.for_each([&copy](const T &data) { copy.emplace_back(data); });
+
+                // The chunks move together with the allocator that made them
+                if constexpr (propagate)
+                    std::swap(chunkAllocator, copy.chunkAllocator);
+                swap_blocks(copy);
+            }
+            return *this;
+        }
+
+        /**
+         * Takes over other's chunks, leaving other empty.
+         */
+        UnrolledStorage(UnrolledStorage &&other) noexcept
+            : UnrolledStorage(Allocator(other.chunkAllocator))
+        {
+            swap_blocks(other);
+        }
+
+        /**
+         * Takes over other's chunks when the allocator propagates on move assignment or both
+         * allocators are equal. Otherwise the chunks must stay with other's allocator, so the
+         * elements are moved one by one into chunks of this storage's allocator.
+         */
+        UnrolledStorage &operator=(UnrolledStorage &&other)
+        {
+            if (this == &other)
+                return *this;
+
+            constexpr bool propagate = ChunkTraits::propagate_on_container_move_assignment::value;
+            if (propagate || chunkAllocator == other.chunkAllocator)
+            {
+                UnrolledStorage taken(std::move(other));
+                if constexpr (propagate)
+                    std::swap(chunkAllocator, taken.chunkAllocator);
+                swap_blocks(taken);
+            }
+            else
+            {
+                UnrolledStorage moved{Allocator(chunkAllocator)};
+                moved.reserve(other.count);
+                for (Cursor pos = other.begin(); pos != other.end(); ++pos)
+                    moved.emplace_back(std::move(*pos));
+                swap_blocks(moved);
+                other.clear();
+            }
+            return *this;
+        }
+
+        /**
+         * Like LinkedStorage, the chunks are left to a pool that frees everything at once
+         * when the elements need no destructor.
+         */
+        ~UnrolledStorage()
+        {
+            if (!(std::is_trivially_destructible<T>::value && releases_in_bulk(chunkAllocator)))
+                clear();
+            reserved.release(chunkAllocator);
+        }
+
+        /**
+         * @return a copy of the allocator used for the elements
+         */
+        Allocator get_allocator() const
+        {
+            return Allocator(chunkAllocator);
+        }
+
+        Cursor begin() { return Cursor(head, 0); }
+        Cursor end() { return Cursor(nullptr, 0); }
+        Cursor last() { return tail == nullptr ? end() : Cursor(tail, tail->used - 1); }
+
+        /**
+         * @return the position before position in insertion order, end() before the first
+         */
+        Cursor before(Cursor position)
+        {
+            if (position.slot > 0)
+                return Cursor(position.chunk, position.slot - 1);
+            Chunk *chunk = position.chunk->prev;
+            return chunk == nullptr ? end() : Cursor(chunk, chunk->used - 1);
+        }
+
+        /**
+         * @return the position of the i-th element in insertion order (i < size()), found
+         * by skipping whole chunks
+         */
+        Cursor at(std::size_t i)
+        {
+            Chunk *chunk = head;
+            while (i >= chunk->used)
+            {
+                i -= chunk->used;
+                chunk = chunk->next;
+            }
+            return Cursor(chunk, i);
+        }
+
+        /**
+         * Calls visit on every element in insertion order, chunk by chunk.
+         * @param visit - callable taking a const T&
+         */
+        template<typename Visitor>
+        void for_each(Visitor visit) const
+        {
+            for (const Chunk *chunk = head; chunk != nullptr; chunk = chunk->next)
+                for (std::size_t i = 0; i < chunk->used; ++i)
+                    visit(*chunk->at(i));
+        }
+
+        /**
+         * @return the number of stored elements
+         */
+        std::size_t size() const
+        {
+            return count;
+        }
+
+        /**
+         * Constructs a new element from args after the last element, starting a new chunk
+         * only when the last one is full.
+         * @param args - the constructor arguments of the element
+         * @return the new element
+         */
+        template<typename... Args>
+        T &emplace_back(Args &&...args)
+        {
+            if (tail != nullptr && tail->used < ChunkCapacity)
+            {
+                T *element = tail->at(tail->used);
+                ChunkTraits::construct(chunkAllocator, element, std::forward<Args>(args)...);
+                ++tail->used;
+                ++count;
+                return *element;
+            }
+
+            // The new chunk is only linked once its first element exists, chunks are never empty
+            Chunk *chunk = reserved.take();
+            if (chunk == nullptr)
+                chunk = ChunkTraits::allocate(chunkAllocator, 1);
+            ::new (static_cast<void *>(chunk)) Chunk();
+            BlockGuard guard([this, chunk] { free_chunk(chunk); });
+            ChunkTraits::construct(chunkAllocator, chunk->at(0), std::forward<Args>(args)...);
+            guard.dismiss();
+            chunk->used = 1;
+
+            chunk->prev = tail;
+            if (tail == nullptr)
+                head = chunk;
+            else
+                tail->next = chunk;
+            tail = chunk;
+            ++count;
+            return *chunk->at(0);
+        }
+
+        /**
+         * Allocates the chunks needed to reach n elements in one slab, so the following adds
+         * take their chunks from it instead of allocating one by one.
+         * @param n - the number of elements to make room for
+         */
+        void reserve(std::size_t n)
+        {
+            std::size_t room = tail == nullptr ? 0 : ChunkCapacity - tail->used;
+            if (n > count + room)
+                reserved.reserve(chunkAllocator, (n - count - room + ChunkCapacity - 1) / ChunkCapacity);
+        }
+
+        /**
+         * Appends the elements of [first, last) in order. When the range size is known up
+         * front all the new chunks come from a single allocation.
+         * @return how many elements were appended
+         */
+        template<typename InputIt>
+        std::size_t append_range(InputIt first, InputIt last)
+        {
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value)
+                reserve(count + static_cast<std::size_t>(std::distance(first, last)));
+
+            std::size_t appended = 0;
+            for (; first != last; ++first, ++appended)
+                emplace_back(*first);
+            return appended;
+        }
+
+        /**
+         * Removes every element matching the predicate while keeping the others in order.
+         * Each chunk is compacted in place, emptied chunks are freed and a chunk that fits
+         * into the one before it is merged into it, so the list stays dense.
+         * @param pred - callable taking a const T& and returning true for elements to remove
+         * @return how many elements were removed
+         */
+        template<typename Predicate>
+        std::size_t erase_if(Predicate pred)
+        {
+            std::size_t removed = 0;
+            Chunk *prev = nullptr;
+            Chunk *chunk = head;
+            while (chunk != nullptr)
+            {
+                // Compact the survivors to the front of this chunk
+                std::size_t kept = 0;
+                for (std::size_t i = 0; i < chunk->used; ++i)
+                {
+                    if (pred(*chunk->at(i)))
+                    {
+                        ++removed;
+                        continue;
+                    }
+                    if (kept != i)
+                        *chunk->at(kept) = std::move(*chunk->at(i));
+                    ++kept;
+                }
+                for (std::size_t i = kept; i < chunk->used; ++i)
+                    ChunkTraits::destroy(chunkAllocator, chunk->at(i));
+                chunk->used = kept;
+
+                // Move the survivors into the previous chunk when they fit there
+                if (prev != nullptr && prev->used + chunk->used <= ChunkCapacity)
+                {
+                    for (std::size_t i = 0; i < chunk->used; ++i)
+                    {
+                        ChunkTraits::construct(chunkAllocator, prev->at(prev->used), std::move(*chunk->at(i)));
+                        ChunkTraits::destroy(chunkAllocator, chunk->at(i));
+                        ++prev->used;
+                    }
+                    chunk->used = 0;
+                }
+
+                Chunk *next = chunk->next;
+                if (chunk->used == 0)
+                {
+                    if (prev == nullptr)
+                        head = next;
+                    else
+                        prev->next = next;
+                    if (next != nullptr)
+                        next->prev = prev;
+                    free_chunk(chunk);
+                }
+                else
+                {
+                    prev = chunk;
+                }
+                chunk = next;
+            }
+
+            tail = prev;
+            count -= removed;
+            return removed;
+        }
+
+        /**
+         * Destroys every element and frees the chunks.
+         */
+        void clear()
+        {
+            while (head != nullptr)
+            {
+                Chunk *toDel = head;
+                head = head->next;
+                for (std::size_t i = 0; i < toDel->used; ++i)
+                    ChunkTraits::destroy(chunkAllocator, toDel->at(i));
+                free_chunk(toDel);
+            }
+            tail = nullptr;
+            count = 0;
+        }
+
+    private:
+        void free_chunk(Chunk *chunk)
+        {
+            if (!reserved.give_back(chunkAllocator, chunk))
+                ChunkTraits::deallocate(chunkAllocator, chunk, 1);
+        }
+
+        /// Exchanges the chunks (and the reserve they came from), not the allocators
+        void swap_blocks(UnrolledStorage &other) noexcept
+        {
+            std::swap(reserved, other.reserved);
+            std::swap(head, other.head);
+            std::swap(tail, other.tail);
+            std::swap(count, other.count);
+        }
+    };
+}
@@ -0,0 +1,150 @@
+//shaked1mi@gmail.com
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "MyContainer.hpp"
+
+using namespace customContainer;
+
+/*
+ * Builds and walks one MyContainer<char> with more elements than an int can count,
+ * 2^31 + 3 by default:
+ *
+ *     ./stress [elements] [--unrolled] [--no-sort]
+ *
+ * The elements live in ContiguousStorage (one byte each) or, with --unrolled, in
+ * UnrolledStorage (about 1.4 bytes each). The sorted orders need 8 more bytes per element
+ * for their permutation and another 8 while it is counting sorted; --no-sort skips them.
+ * Every order is checked against the element count and the values it must yield, and the
+ * program exits with status 1 on the first mismatch.
+ */
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Runs work once and returns how long it took in milliseconds.
+     */
+    template<typename Work>
+    double time_ms(Work work)
+    {
+        auto start = Clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void print_row(const std::string &name, double ms)
+    {
+        std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(12)
+                  << std::fixed << std::setprecision(2) << ms << " ms\n";
+    }
+
+    /**
+     * The value stored at position i, cycling through the 26 lower case letters.
+     */
+    char letter(std::size_t i)
+    {
+        return static_cast<char>('a' + i % 26);
+    }
+
+    void check(bool ok, const std::string &what)
+    {
+        if (ok)
+            return;
+        std::cerr << "stress: " << what << " failed\n";
+        std::exit(1);
+    }
+
+    /**
+     * Counts the elements of an order and checks that it starts with first.
+     */
+    template<typename View>
+    void check_walk(const std::string &name, View view, std::size_t n, char first)
+    {
+        std::size_t count = 0;
+        bool firstMatches = false;
+        print_row(name, time_ms([&] {
+            for (char c : view)
+            {
+                if (count == 0)
+                    firstMatches = c == first;
+                ++count;
+            }
+        }));
+        check(count == n, name + " element count");
+        check(firstMatches, name + " first element");
+    }
+
+    template<typename Container>
+    void stress(const std::string &label, std::size_t n, bool sorted)
+    {
+        std::cout << label << ", " << n << " elements\n";
+        Container container;
+        print_row("add", time_ms([&] {
+            container.reserve(n);
+            for (std::size_t i = 0; i < n; ++i)
+                container.add(letter(i));
+        }));
+        check(container.size() == n, "size()");
+
+        std::size_t count = 0;
+        bool inOrder = true;
+        print_row("insertion order", time_ms([&] {
+            for (auto it = container.begin_order(); it != container.end_order(); ++it)
+                inOrder &= *it == letter(count++);
+        }));
+        check(count == n && inOrder, "insertion order");
+
+        check_walk("reverse order", container.reverse(), n, letter(n - 1));
+        check_walk("middle-out order", container.middle_out(), n, letter(n / 2));
+        if (!sorted)
+            return;
+
+        count = 0;
+        inOrder = true;
+        char previous = 'a';
+        print_row("ascending order", time_ms([&] {
+            for (char c : container.ascending())
+            {
+                inOrder &= previous <= c;
+                previous = c;
+                ++count;
+            }
+        }));
+        check(count == n && inOrder, "ascending order");
+        check_walk("descending order", container.descending(), n, n > 25 ? 'z' : letter(n - 1));
+        check_walk("side-cross order", container.side_cross(), n, 'a');
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t n = (std::size_t(1) << 31) + 3;
+    bool unrolled = false;
+    bool sorted = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--unrolled") == 0)
+            unrolled = true;
+        else if (std::strcmp(argv[i], "--no-sort") == 0)
+            sorted = false;
+        else
+            n = std::strtoull(argv[i], nullptr, 10);
+    }
+    if (n == 0)
+    {
+        std::cerr << "usage: stress [elements] [--unrolled] [--no-sort]\n";
+        return 2;
+    }
+
+    if (unrolled)
+        stress<MyContainer<char, UnrolledStorage>>("MyContainer<char, UnrolledStorage>", n, sorted);
+    else
+        stress<MyContainer<char, ContiguousStorage>>("MyContainer<char, ContiguousStorage>", n, sorted);
+    std::cout << "ok\n";
+    return 0;
+}
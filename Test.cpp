@@ -3,13 +3,24 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "MyContainer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 using namespace customContainer;
 
 // Helper to convert container contents (via operator<<) into a string
-template<typename T>
-std::string container_to_string(const MyContainer<T> &c)
+template<typename T, template<typename, typename> class Storage, typename Allocator>
+std::string container_to_string(const MyContainer<T, Storage, Allocator> &c)
 {
     std::ostringstream oss;
     oss << c;
@@ -22,6 +33,8 @@ TEST_SUITE("MyContainer basic operations")
     {
         MyContainer<int> container;
         CHECK(container.size() == 0u);
+        // Counts past 2^31 elements must not wrap, see Stress.cpp
+        static_assert(std::is_same<decltype(container.size()), std::size_t>::value, "size() counts in std::size_t");
         // operator<< of an empty container should produce an empty stream
         CHECK(container_to_string(container) == "");
     }
@@ -71,6 +84,29 @@ TEST_SUITE("MyContainer basic operations")
         CHECK(container.size() == 0u);
         CHECK(container_to_string(container) == "");
     }
+
+    TEST_CASE("add() after remove() keeps appending at the tail")
+    {
+        MyContainer<int> container;
+        container.add(1);
+        container.add(2);
+        container.add(3);
+
+        // Removing the last element must move the tail back to the new last node
+        container.remove(3);
+        container.add(4);
+        CHECK(container.size() == 3u);
+        CHECK(container_to_string(container) == "[1, 2, 4, ]");
+
+        // Emptying the container must reset the tail as well
+        container.remove(1);
+        container.remove(2);
+        container.remove(4);
+        CHECK(container.size() == 0u);
+        container.add(7);
+        CHECK(container.size() == 1u);
+        CHECK(container_to_string(container) == "[7, ]");
+    }
 }
 
 TEST_SUITE("MyContainer iteration orders")
@@ -194,6 +230,1612 @@ TEST_SUITE("MyContainer iteration orders")
     }
 }
 
+TEST_SUITE("order views")
+{
+    TEST_CASE("range-based for over every view")
+    {
+        MyContainer<int> container;
+        container.add(3);
+        container.add(1);
+        container.add(4);
+        container.add(2);
+
+        std::vector<int> asc, desc, cross, rev, mid;
+        for (int x : container.ascending())
+            asc.push_back(x);
+        for (int x : container.descending())
+            desc.push_back(x);
+        for (int x : container.side_cross())
+            cross.push_back(x);
+        for (int x : container.reverse())
+            rev.push_back(x);
+        for (int x : container.middle_out())
+            mid.push_back(x);
+
+        CHECK(asc == std::vector<int>{1, 2, 3, 4});
+        CHECK(desc == std::vector<int>{4, 3, 2, 1});
+        CHECK(cross == std::vector<int>{1, 4, 2, 3});
+        CHECK(rev == std::vector<int>{2, 4, 1, 3});
+        CHECK(mid == std::vector<int>{4, 1, 2, 3});
+    }
+
+    TEST_CASE("views over an empty container")
+    {
+        MyContainer<int> container;
+        CHECK(container.ascending().begin() == container.ascending().end());
+        CHECK(container.side_cross().begin() == container.side_cross().end());
+        CHECK(container.reverse().begin() == container.reverse().end());
+        CHECK(container.middle_out().begin() == container.middle_out().end());
+    }
+
+    TEST_CASE("a view can be iterated more than once")
+    {
+        MyContainer<char> container;
+        container.add('b');
+        container.add('a');
+        auto view = container.descending();
+
+        std::string first, second;
+        for (char c : view)
+            first += c;
+        for (char c : view)
+            second += c;
+        CHECK(first == "ba");
+        CHECK(second == "ba");
+    }
+
+    TEST_CASE("a view follows changes made between two loops")
+    {
+        MyContainer<int> numbers{5, 3, 1, 4, 2};
+        auto ascending = numbers.ascending();
+        std::vector<int> before, after;
+        for (int x : ascending)
+            before.push_back(x);
+        numbers.remove(1);
+        numbers.remove(5);
+        for (int x : ascending)
+            after.push_back(x);
+        CHECK(before == std::vector<int>{1, 2, 3, 4, 5});
+        CHECK(after == std::vector<int>{2, 3, 4});
+
+        MyContainer<int, ContiguousStorage> contiguous{1, 2};
+        auto reverse = contiguous.reverse();
+        auto middle = contiguous.middle_out();
+        CHECK(*reverse.begin() == 2);
+        CHECK(*middle.begin() == 2);
+        for (int x = 3; x <= 100; ++x)
+            contiguous.add(x);
+        std::vector<int> reversed;
+        for (int x : reverse)
+            reversed.push_back(x);
+        CHECK(reversed.size() == 100u);
+        CHECK(reversed.front() == 100);
+        CHECK(reversed.back() == 1);
+        CHECK(*middle.begin() == 51);
+    }
+}
+
+// Checks the random-access operations of an order against the elements it must yield
+template<typename Iterator>
+void check_jumps(Iterator first, Iterator last, const std::vector<int> &expected)
+{
+    const auto n = static_cast<std::ptrdiff_t>(expected.size());
+    CHECK(std::distance(first, last) == n);
+    CHECK(last - first == n);
+    CHECK(std::vector<int>(first, last) == expected);
+
+    std::vector<int> backwards;
+    for (Iterator it = last; it != first;)
+        backwards.push_back(*--it);
+    CHECK(backwards == std::vector<int>(expected.rbegin(), expected.rend()));
+
+    for (std::ptrdiff_t k = 0; k < n; k += std::max<std::ptrdiff_t>(1, n / 40))
+    {
+        CHECK(first[k] == expected[k]);
+        CHECK(*(last - (n - k)) == expected[k]);
+        Iterator it = first;
+        std::advance(it, k);
+        CHECK(*it == expected[k]);
+        CHECK(it - first == k);
+        CHECK(first <= it);
+        CHECK(it < last);
+        it -= k;
+        CHECK(it == first);
+    }
+}
+
+TEST_SUITE("iterator traits")
+{
+    TEST_CASE("iterator categories")
+    {
+        using Linked = MyContainer<int, LinkedStorage>;
+        using Contiguous = MyContainer<int, ContiguousStorage>;
+        using std::is_same;
+        static_assert(is_same<std::iterator_traits<Linked::AscendingOrder>::iterator_category,
+                              std::random_access_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::DescendingOrder>::iterator_category,
+                              std::random_access_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::SideCrossOrder>::iterator_category,
+                              std::random_access_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Contiguous::ReverseOrder>::iterator_category,
+                              std::random_access_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Contiguous::MiddleOutOrder>::iterator_category,
+                              std::random_access_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::ReverseOrder>::iterator_category,
+                              std::bidirectional_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::MiddleOutOrder>::iterator_category,
+                              std::bidirectional_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::Order>::iterator_category,
+                              std::forward_iterator_tag>::value, "");
+        static_assert(is_same<std::iterator_traits<Linked::Order>::value_type, int>::value, "");
+        CHECK(true);
+    }
+
+    TEST_CASE_TEMPLATE("every order jumps, steps back and measures distances", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>)
+    {
+        for (int n : {0, 1, 2, 100, 5001})
+        {
+            std::mt19937 random(static_cast<unsigned>(n));
+            std::vector<int> values(static_cast<std::size_t>(n));
+            for (int &value : values)
+                value = static_cast<int>(random() % 1000);
+            Container container(values.begin(), values.end());
+
+            std::vector<int> asc = values;
+            std::sort(asc.begin(), asc.end());
+            std::vector<int> desc(asc.rbegin(), asc.rend());
+            std::vector<int> cross, mid;
+            for (std::size_t lo = 0, hi = asc.size(); lo < hi;)
+            {
+                cross.push_back(asc[lo++]);
+                if (lo < hi)
+                    cross.push_back(asc[--hi]);
+            }
+            for (std::size_t k = 0; k < values.size(); ++k)
+                mid.push_back(values[k % 2 == 1 ? values.size() / 2 - (k + 1) / 2 : values.size() / 2 + k / 2]);
+
+            check_jumps(container.begin_ascending_order(), container.end_ascending_order(), asc);
+            check_jumps(container.begin_descending_order(), container.end_descending_order(), desc);
+            check_jumps(container.begin_side_cross_order(), container.end_side_cross_order(), cross);
+            check_jumps(container.begin_reverse_order(), container.end_reverse_order(),
+                        std::vector<int>(values.rbegin(), values.rend()));
+            check_jumps(container.begin_middle_out_order(), container.end_middle_out_order(), mid);
+            CHECK(std::vector<int>(container.begin_order(), container.end_order()) == values);
+        }
+    }
+
+    TEST_CASE("binary search over the sorted orders")
+    {
+        MyContainer<int> container;
+        for (int x = 0; x < 10000; ++x)
+            container.add((x * 7919) % 10000);
+
+        auto asc = container.ascending();
+        auto found = std::lower_bound(asc.begin(), asc.end(), 4242);
+        CHECK(*found == 4242);
+        CHECK(found - asc.begin() == 4242);
+
+        auto desc = container.descending();
+        auto below = std::upper_bound(desc.begin(), desc.end(), 100, std::greater<int>());
+        CHECK(*below == 99);
+        CHECK(desc.end() - below == 100);
+    }
+}
+
+TEST_SUITE("sorted order cache")
+{
+    TEST_CASE("sorted orders follow add() and remove()")
+    {
+        MyContainer<int> container;
+        container.add(5);
+        container.add(1);
+        container.add(3);
+
+        std::vector<int> before;
+        for (int x : container.ascending())
+            before.push_back(x);
+        CHECK(before == std::vector<int>{1, 3, 5});
+
+        // Every mutation must invalidate the shared permutation
+        container.add(0);
+        container.remove(3);
+
+        std::vector<int> asc, desc, cross;
+        for (int x : container.ascending())
+            asc.push_back(x);
+        for (int x : container.descending())
+            desc.push_back(x);
+        for (int x : container.side_cross())
+            cross.push_back(x);
+        CHECK(asc == std::vector<int>{0, 1, 5});
+        CHECK(desc == std::vector<int>{5, 1, 0});
+        CHECK(cross == std::vector<int>{0, 5, 1});
+    }
+
+    TEST_CASE("sorted orders hand out read-only elements")
+    {
+        using Container = MyContainer<int>;
+        using std::is_same;
+        static_assert(is_same<decltype(*std::declval<Container::AscendingOrder>()), const int &>::value, "");
+        static_assert(is_same<decltype(*std::declval<Container::DescendingOrder>()), const int &>::value, "");
+        static_assert(is_same<decltype(*std::declval<Container::SideCrossOrder>()), const int &>::value, "");
+        static_assert(is_same<std::iterator_traits<Container::AscendingOrder>::reference, const int &>::value, "");
+        static_assert(is_same<std::iterator_traits<Container::AscendingOrder>::value_type, int>::value, "");
+        static_assert(is_same<decltype(std::declval<Container::SideCrossOrder>()[0]), const int &>::value, "");
+        static_assert(is_same<decltype(*std::declval<Container::Order>()), int &>::value, "");
+
+        // Changing how an element sorts goes through remove() and add(), which the cache sees
+        Container container{4, 2, 9};
+        CHECK(*container.begin_ascending_order() == 2);
+        container.remove(2);
+        container.add(10);
+        std::vector<int> asc;
+        for (int x : container.ascending())
+            asc.push_back(x);
+        CHECK(asc == std::vector<int>{4, 9, 10});
+    }
+
+    TEST_CASE("a failed remove() keeps the sorted orders intact")
+    {
+        MyContainer<int> container;
+        container.add(2);
+        container.add(1);
+        CHECK_THROWS_AS(container.remove(9), std::out_of_range);
+
+        std::vector<int> asc;
+        for (int x : container.ascending())
+            asc.push_back(x);
+        CHECK(asc == std::vector<int>{1, 2});
+    }
+
+    TEST_CASE("side-cross with an odd number of elements")
+    {
+        MyContainer<int> container;
+        for (int x : {7, 15, 6, 1, 2})
+            container.add(x);
+
+        std::vector<int> cross;
+        for (int x : container.side_cross())
+            cross.push_back(x);
+        CHECK(cross == std::vector<int>{1, 15, 2, 7, 6});
+    }
+}
+
+TEST_SUITE("storage policies")
+{
+    // Collects an iteration order into a vector so it can be compared in one CHECK
+    template<typename Iterator>
+    std::vector<int> collect(Iterator first, Iterator last)
+    {
+        std::vector<int> result;
+        for (; first != last; ++first)
+            result.push_back(*first);
+        return result;
+    }
+
+    TEST_CASE_TEMPLATE("every order works with every storage", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>, MyContainer<int, LinkedStorage, PoolAllocator<int>>,
+                       MyContainer<int, UnrolledStorage, PoolAllocator<int>>)
+    {
+        Container container;
+        for (int x : {7, 15, 6, 1, 2})
+            container.add(x);
+        CHECK(container.size() == 5u);
+        CHECK(container_to_string(container) == "[7, 15, 6, 1, 2, ]");
+
+        CHECK(collect(container.begin_order(), container.end_order()) == std::vector<int>{7, 15, 6, 1, 2});
+        CHECK(collect(container.begin_ascending_order(), container.end_ascending_order()) ==
+              std::vector<int>{1, 2, 6, 7, 15});
+        CHECK(collect(container.begin_descending_order(), container.end_descending_order()) ==
+              std::vector<int>{15, 7, 6, 2, 1});
+        CHECK(collect(container.begin_side_cross_order(), container.end_side_cross_order()) ==
+              std::vector<int>{1, 15, 2, 7, 6});
+        CHECK(collect(container.begin_reverse_order(), container.end_reverse_order()) ==
+              std::vector<int>{2, 1, 6, 15, 7});
+        CHECK(collect(container.begin_middle_out_order(), container.end_middle_out_order()) ==
+              std::vector<int>{6, 15, 1, 7, 2});
+
+        container.remove(6);
+        CHECK(container.size() == 4u);
+        CHECK(container_to_string(container) == "[7, 15, 1, 2, ]");
+        CHECK(collect(container.begin_ascending_order(), container.end_ascending_order()) ==
+              std::vector<int>{1, 2, 7, 15});
+        CHECK_THROWS_AS(container.remove(6), std::out_of_range);
+    }
+
+    TEST_CASE_TEMPLATE("copies are independent", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>, MyContainer<int, LinkedStorage, PoolAllocator<int>>,
+                       MyContainer<int, UnrolledStorage, PoolAllocator<int>>)
+    {
+        Container original;
+        original.add(2);
+        original.add(1);
+        CHECK(collect(original.begin_ascending_order(), original.end_ascending_order()) == std::vector<int>{1, 2});
+
+        Container copy = original;
+        copy.add(0);
+        original.remove(2);
+
+        CHECK(container_to_string(original) == "[1, ]");
+        CHECK(container_to_string(copy) == "[2, 1, 0, ]");
+        CHECK(collect(copy.begin_ascending_order(), copy.end_ascending_order()) == std::vector<int>{0, 1, 2});
+
+        copy = original;
+        CHECK(container_to_string(copy) == "[1, ]");
+        CHECK(collect(copy.begin_descending_order(), copy.end_descending_order()) == std::vector<int>{1});
+    }
+
+    TEST_CASE("unrolled storage across many chunks")
+    {
+        MyContainer<char, UnrolledStorage> container;
+        constexpr std::size_t perChunk = UnrolledStorage<char>::ChunkCapacity;
+        const std::size_t n = perChunk * 3 + 5;
+        for (std::size_t i = 0; i < n; ++i)
+            container.add(static_cast<char>('a' + i % 26));
+        CHECK(container.size() == n);
+
+        // Remove a letter that appears in every chunk, the rest must keep insertion order
+        container.remove('c');
+        std::string expected, actual;
+        for (std::size_t i = 0; i < n; ++i)
+            if (i % 26 != 2)
+                expected += static_cast<char>('a' + i % 26);
+        for (auto it = container.begin_order(); it != container.end_order(); ++it)
+            actual += *it;
+        CHECK(actual == expected);
+        CHECK(container.size() == expected.size());
+
+        std::string reversed;
+        for (char c : container.reverse())
+            reversed += c;
+        CHECK(reversed == std::string(expected.rbegin(), expected.rend()));
+
+        // Appending after removals must still land at the very end
+        container.add('!');
+        auto last = container.begin_reverse_order();
+        CHECK(*last == '!');
+    }
+
+    TEST_CASE("unrolled storage with non-trivial elements")
+    {
+        MyContainer<std::string, UnrolledStorage> container;
+        for (int i = 0; i < 10; ++i)
+            container.add(std::to_string(i));
+        container.remove("3");
+        container.remove("4");
+        container.remove("5");
+        CHECK(container_to_string(container) == "[0, 1, 2, 6, 7, 8, 9, ]");
+
+        std::vector<std::string> asc;
+        for (const std::string &value : container.ascending())
+            asc.push_back(value);
+        CHECK(asc == std::vector<std::string>{"0", "1", "2", "6", "7", "8", "9"});
+    }
+}
+
+TEST_SUITE("node pool allocator")
+{
+    TEST_CASE("removed nodes are recycled instead of growing the pool")
+    {
+        PoolAllocator<int> allocator;
+        MyContainer<int, LinkedStorage, PoolAllocator<int>> container(allocator);
+        for (int i = 0; i < 1000; ++i)
+            container.add(i);
+        const std::size_t slabs = allocator.get_pool().slab_count();
+        CHECK(slabs > 0u);
+
+        // Churn: every removal frees a node that the next add() takes back
+        for (int round = 0; round < 10; ++round)
+        {
+            for (int i = 0; i < 1000; i += 2)
+                container.remove(i);
+            for (int i = 0; i < 1000; i += 2)
+                container.add(i);
+        }
+        CHECK(container.size() == 1000u);
+        CHECK(allocator.get_pool().slab_count() == slabs);
+        CHECK(container.get_allocator() == allocator);
+    }
+
+    TEST_CASE("copies get a pool of their own")
+    {
+        MyContainer<int, LinkedStorage, PoolAllocator<int>> original;
+        original.add(1);
+        MyContainer<int, LinkedStorage, PoolAllocator<int>> copy(original);
+        CHECK(copy.get_allocator() != original.get_allocator());
+        CHECK(container_to_string(copy) == "[1, ]");
+    }
+
+    TEST_CASE("elements with destructors are still destroyed")
+    {
+        MyContainer<std::string, LinkedStorage, PoolAllocator<std::string>> container;
+        container.add(std::string(100, 'x'));
+        container.add("short");
+        container.remove("short");
+        CHECK(container.size() == 1u);
+    }
+}
+
+// Forwards to new/delete while counting how many allocations went through it
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t align) override
+    {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST_SUITE("pmr memory resources")
+{
+    TEST_CASE("nodes and ordering lists come from the resource")
+    {
+        CountingResource resource;
+        {
+            customContainer::pmr::MyContainer<int> container(&resource);
+            for (int x : {3, 1, 4, 2})
+                container.add(x);
+            const std::size_t afterAdd = resource.allocations;
+            CHECK(afterAdd >= 4u);
+
+            std::vector<int> asc, rev, mid;
+            for (int x : container.ascending())
+                asc.push_back(x);
+            for (int x : container.reverse())
+                rev.push_back(x);
+            for (int x : container.middle_out())
+                mid.push_back(x);
+            CHECK(asc == std::vector<int>{1, 2, 3, 4});
+            CHECK(rev == std::vector<int>{2, 4, 1, 3});
+            CHECK(mid == std::vector<int>{4, 1, 2, 3});
+            CHECK(resource.allocations > afterAdd);
+
+            container.remove(4);
+            CHECK(container_to_string(container) == "[3, 1, 2, ]");
+        }
+        // Everything was handed back to the resource
+        CHECK(resource.live == 0u);
+    }
+
+    TEST_CASE_TEMPLATE("reverse and middle-out orders allocate nothing", Container,
+                       customContainer::pmr::MyContainer<int, LinkedStorage>,
+                       customContainer::pmr::MyContainer<int, ContiguousStorage>,
+                       customContainer::pmr::MyContainer<int, UnrolledStorage>)
+    {
+        CountingResource resource;
+        {
+            Container container(&resource);
+            for (int x = 0; x < 200; ++x)
+                container.add(x);
+            // Drop a few whole chunks and some single elements so the walks cross gaps
+            container.remove_if([](int x) { return (x >= 40 && x < 120) || x % 7 == 0; });
+            std::vector<int> kept;
+            for (auto it = container.begin_order(); it != container.end_order(); ++it)
+                kept.push_back(*it);
+
+            const std::size_t before = resource.allocations;
+            std::vector<int> rev, mid;
+            for (int x : container.reverse())
+                rev.push_back(x);
+            for (int x : container.middle_out())
+                mid.push_back(x);
+            CHECK(resource.allocations == before);
+
+            CHECK(rev == std::vector<int>(kept.rbegin(), kept.rend()));
+            std::vector<int> expected;
+            std::size_t middle = kept.size() / 2, left = middle, right = middle;
+            expected.push_back(kept[middle]);
+            while (expected.size() < kept.size())
+            {
+                if (left > 0)
+                    expected.push_back(kept[--left]);
+                if (right + 1 < kept.size())
+                    expected.push_back(kept[++right]);
+            }
+            CHECK(mid == expected);
+        }
+        CHECK(resource.live == 0u);
+    }
+
+    TEST_CASE_TEMPLATE("assignment keeps the target's memory resource", Container,
+                       customContainer::pmr::MyContainer<int, LinkedStorage>,
+                       customContainer::pmr::MyContainer<int, ContiguousStorage>,
+                       customContainer::pmr::MyContainer<int, UnrolledStorage>)
+    {
+        CountingResource sourceResource, targetResource;
+        {
+            Container source(&sourceResource);
+            Container target(&targetResource);
+            target.add(7);
+            for (int x = 0; x < 100; ++x)
+                source.add(x);
+            const std::size_t sourceAllocations = sourceResource.allocations;
+
+            target = source;
+            CHECK(container_to_string(target) == container_to_string(source));
+            CHECK(sourceResource.allocations == sourceAllocations);
+            CHECK(targetResource.allocations > 1u);
+
+            source.remove(5);
+            target.add(100);
+            CHECK(target.size() == 101u);
+            CHECK(*target.begin_descending_order() == 100);
+        }
+        CHECK(sourceResource.live == 0u);
+        CHECK(targetResource.live == 0u);
+    }
+
+    TEST_CASE_TEMPLATE("move assignment between memory resources", Container,
+                       customContainer::pmr::MyContainer<std::pmr::string, LinkedStorage>,
+                       customContainer::pmr::MyContainer<std::pmr::string, ContiguousStorage>,
+                       customContainer::pmr::MyContainer<std::pmr::string, UnrolledStorage>)
+    {
+        CountingResource sourceResource, targetResource;
+        {
+            Container source(&sourceResource);
+            Container target(&targetResource);
+            for (const char *word : {"pear", "fig", "apple"})
+                source.add(std::pmr::string(word, &sourceResource));
+            source.enable_index();
+            CHECK(*source.begin_ascending_order() == "apple");
+
+            const std::size_t sourceAllocations = sourceResource.allocations;
+            target = std::move(source);
+            CHECK(sourceResource.allocations == sourceAllocations);
+            CHECK(container_to_string(target) == "[pear, fig, apple, ]");
+            CHECK(*target.begin_ascending_order() == "apple");
+            CHECK(target.indexed());
+            CHECK(target.count("fig") == 1u);
+            CHECK(source.size() == 0u);
+
+            Container same(&targetResource);
+            same = std::move(target);
+            CHECK(container_to_string(same) == "[pear, fig, apple, ]");
+            CHECK(same.count("pear") == 1u);
+        }
+        CHECK(sourceResource.live == 0u);
+        CHECK(targetResource.live == 0u);
+    }
+
+    TEST_CASE("containers on a monotonic arena")
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        customContainer::pmr::MyContainer<char, UnrolledStorage> letters(&arena);
+        customContainer::pmr::MyContainer<std::pmr::string> words(&arena);
+        for (char c : std::string("arena"))
+            letters.add(c);
+        words.add("monotonic");
+        words.add("buffer");
+
+        std::string sorted;
+        for (char c : letters.ascending())
+            sorted += c;
+        CHECK(sorted == "aaenr");
+        CHECK(*words.begin_ascending_order() == "buffer");
+        CHECK(words.get_allocator().resource() == &arena);
+    }
+}
+
+TEST_SUITE("move-aware insertion")
+{
+    // Counts how often values of this type are copied or moved
+    struct Tracked
+    {
+        static int copies;
+        static int moves;
+        std::string value;
+
+        explicit Tracked(std::string value) : value(std::move(value)) {}
+        Tracked(const Tracked &other) : value(other.value) { ++copies; }
+        Tracked(Tracked &&other) noexcept : value(std::move(other.value)) { ++moves; }
+        Tracked &operator=(const Tracked &other) { value = other.value; ++copies; return *this; }
+        Tracked &operator=(Tracked &&other) noexcept { value = std::move(other.value); ++moves; return *this; }
+        bool operator<(const Tracked &other) const { return value < other.value; }
+        bool operator==(const Tracked &other) const { return value == other.value; }
+
+        static void reset() { copies = moves = 0; }
+    };
+    int Tracked::copies = 0;
+    int Tracked::moves = 0;
+
+    TEST_CASE_TEMPLATE("add() and emplace() construct each element once", Container,
+                       MyContainer<Tracked, LinkedStorage>, MyContainer<Tracked, UnrolledStorage>)
+    {
+        Container container;
+        Tracked lvalue("copied");
+
+        Tracked::reset();
+        container.add(lvalue);
+        CHECK(Tracked::copies == 1);
+        CHECK(Tracked::moves == 0);
+
+        Tracked::reset();
+        container.add(Tracked("moved"));
+        CHECK(Tracked::copies == 0);
+        CHECK(Tracked::moves == 1);
+
+        Tracked::reset();
+        Tracked &placed = container.emplace("emplaced");
+        CHECK(Tracked::copies == 0);
+        CHECK(Tracked::moves == 0);
+        CHECK(placed.value == "emplaced");
+
+        std::vector<std::string> asc;
+        for (const Tracked &t : container.ascending())
+            asc.push_back(t.value);
+        CHECK(asc == std::vector<std::string>{"copied", "emplaced", "moved"});
+        CHECK(Tracked::copies == 0);
+    }
+
+    TEST_CASE_TEMPLATE("moving a container moves no element", Container,
+                       MyContainer<Tracked, LinkedStorage>, MyContainer<Tracked, ContiguousStorage>,
+                       MyContainer<Tracked, UnrolledStorage>)
+    {
+        static_assert(std::is_nothrow_move_constructible<Container>::value, "vector growth must move");
+        Container source;
+        for (const char *value : {"b", "c", "a"})
+            source.emplace(value);
+        const Tracked *smallest = &*source.begin_ascending_order();
+
+        Tracked::reset();
+        Container moved(std::move(source));
+        Container assigned;
+        assigned.emplace("old");
+        assigned = std::move(moved);
+        CHECK(Tracked::copies == 0);
+        CHECK(Tracked::moves == 0);
+
+        // The elements and the cached sort came along
+        CHECK(&*assigned.begin_ascending_order() == smallest);
+        CHECK(assigned.size() == 3u);
+
+        CHECK(source.size() == 0u);
+        CHECK(moved.size() == 0u);
+        source.emplace("z");
+        CHECK(source.begin_ascending_order()->value == "z");
+
+        std::vector<Container> many(1);
+        many[0].emplace("kept");
+        Tracked::reset();
+        for (int i = 0; i < 20; ++i)
+            many.emplace_back();
+        CHECK(Tracked::copies == 0);
+        CHECK(many[0].begin_order()->value == "kept");
+    }
+
+    TEST_CASE_TEMPLATE("move assignment from a container that was never sorted", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>)
+    {
+        Container source{3, 1, 2};
+        Container target;
+        target = std::move(source);
+        std::vector<int> ascending;
+        for (int value : target.ascending())
+            ascending.push_back(value);
+        CHECK(ascending == std::vector<int>{1, 2, 3});
+        CHECK(*target.begin_descending_order() == 3);
+
+        // A sorted target whose new elements were never sorted must not keep its old order
+        Container sorted{9, 8};
+        CHECK(*sorted.begin_ascending_order() == 8);
+        Container fresh{5, 4, 6};
+        sorted = std::move(fresh);
+        ascending.clear();
+        for (int value : sorted.ascending())
+            ascending.push_back(value);
+        CHECK(ascending == std::vector<int>{4, 5, 6});
+    }
+
+    TEST_CASE("strings are moved, not copied, into the container")
+    {
+        MyContainer<std::string> container;
+        std::string text(64, 'a');
+        const char *buffer = text.data();
+        container.add(std::move(text));
+        // The heap buffer of the string changed owner instead of being copied
+        CHECK(container.begin_order()->data() == buffer);
+
+        container.emplace(3, 'z');
+        CHECK(container_to_string(container) == "[" + std::string(64, 'a') + ", zzz, ]");
+    }
+}
+
+TEST_SUITE("bulk construction")
+{
+    TEST_CASE_TEMPLATE("initializer list and iterator pair constructors", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>, MyContainer<int, LinkedStorage, PoolAllocator<int>>)
+    {
+        Container listed{7, 15, 6, 1, 2};
+        CHECK(listed.size() == 5u);
+        CHECK(container_to_string(listed) == "[7, 15, 6, 1, 2, ]");
+
+        std::vector<int> values{3, 1, 2};
+        Container ranged(values.begin(), values.end());
+        CHECK(container_to_string(ranged) == "[3, 1, 2, ]");
+        CHECK(*ranged.begin_ascending_order() == 1);
+
+        const int more[] = {1, 2, 6, 7, 15};
+        ranged.add_range(std::begin(more), std::end(more));
+        CHECK(container_to_string(ranged) == "[3, 1, 2, 1, 2, 6, 7, 15, ]");
+        CHECK(*ranged.begin_descending_order() == 15);
+    }
+
+    TEST_CASE("add_range() takes single-pass input ranges")
+    {
+        std::istringstream input("4 8 15 16 23 42");
+        MyContainer<int, UnrolledStorage> container;
+        container.add_range(std::istream_iterator<int>(input), std::istream_iterator<int>());
+        CHECK(container_to_string(container) == "[4, 8, 15, 16, 23, 42, ]");
+
+        container.add_range(std::istream_iterator<int>(input), std::istream_iterator<int>());
+        CHECK(container.size() == 6u);
+    }
+
+    TEST_CASE_TEMPLATE("a batch is allocated at once", Container,
+                       customContainer::pmr::MyContainer<int, LinkedStorage>,
+                       customContainer::pmr::MyContainer<int, UnrolledStorage>)
+    {
+        CountingResource resource;
+        std::vector<int> values(1000);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            values[i] = static_cast<int>(i % 37);
+        {
+            Container container(values.begin(), values.end(), &resource);
+            CHECK(container.size() == 1000u);
+            CHECK(resource.allocations == 1u);
+
+            // Nodes freed from the slab are handed back and the slab survives until the end
+            for (int x = 0; x < 20; ++x)
+                container.remove(x);
+            container.add(99);
+            CHECK(*container.begin_descending_order() == 99);
+            CHECK(*container.begin_ascending_order() == 20);
+        }
+        CHECK(resource.live == 0u);
+    }
+
+    TEST_CASE("reserve() makes the following adds allocation-free")
+    {
+        CountingResource resource;
+        {
+            customContainer::pmr::MyContainer<int> container(&resource);
+            container.add(1);
+            container.reserve(101);
+            const std::size_t reserved = resource.allocations;
+            for (int x = 0; x < 100; ++x)
+                container.add(x);
+            CHECK(resource.allocations == reserved);
+            CHECK(container.size() == 101u);
+
+            container.add(100);
+            CHECK(resource.allocations == reserved + 1);
+
+            customContainer::pmr::MyContainer<int> copy(container);
+            CHECK(container_to_string(copy) == container_to_string(container));
+        }
+        CHECK(resource.live == 0u);
+    }
+
+    TEST_CASE_TEMPLATE("reserve() keeps the sorted orders valid", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>)
+    {
+        Container container{3, 1, 2};
+        CHECK(*container.begin_ascending_order() == 1);
+
+        // Growing the buffer of ContiguousStorage moves every element
+        container.reserve(1000);
+        std::vector<int> ascending;
+        for (int value : container.ascending())
+            ascending.push_back(value);
+        CHECK(ascending == std::vector<int>{1, 2, 3});
+        CHECK(*container.begin_side_cross_order() == 1);
+    }
+}
+
+TEST_SUITE("value index")
+{
+    TEST_CASE_TEMPLATE("indexed lookups and removals", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>, MyContainer<int, LinkedStorage, PoolAllocator<int>>)
+    {
+        Container container{5, 3, 5, 1, 5, 2};
+        CHECK(container.count(5) == 3u);
+        CHECK_FALSE(container.indexed());
+
+        container.enable_index();
+        CHECK(container.indexed());
+        CHECK(container.count(5) == 3u);
+        CHECK(container.contains(2));
+        CHECK_FALSE(container.contains(4));
+
+        container.add(4);
+        container.emplace(5);
+        CHECK(container.count(5) == 4u);
+        CHECK(container.contains(4));
+
+        container.remove(5);
+        CHECK(container.count(5) == 0u);
+        CHECK(container.size() == 4u);
+        CHECK(container_to_string(container) == "[3, 1, 2, 4, ]");
+        CHECK_THROWS_AS(container.remove(5), std::out_of_range);
+        CHECK(*container.begin_descending_order() == 4);
+
+        // Adding again after a removal, and removing the first and last elements
+        container.add(3);
+        container.remove(3);
+        container.remove(4);
+        CHECK(container_to_string(container) == "[1, 2, ]");
+        CHECK(container.count(3) == 0u);
+
+        const int batch[] = {7, 7, 1};
+        container.add_range(std::begin(batch), std::end(batch));
+        CHECK(container.count(7) == 2u);
+        CHECK(container.count(1) == 2u);
+
+        Container copy = container;
+        CHECK(copy.indexed());
+        copy.remove(7);
+        CHECK(copy.count(7) == 0u);
+        CHECK(container.count(7) == 2u);
+
+        container.disable_index();
+        CHECK(container.count(1) == 2u);
+        container.remove(1);
+        CHECK(container_to_string(container) == "[2, 7, 7, ]");
+    }
+
+    TEST_CASE_TEMPLATE("remove_if() keeps the indexed positions of the survivors", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, UnrolledStorage>)
+    {
+        Container container;
+        container.enable_index();
+        for (int i = 0; i < 40000; ++i)
+            container.add(i % 4 == 0 ? i : 5);
+
+        // Every other 5 goes, so the entry of 5 keeps half its positions
+        bool drop = false;
+        CHECK(container.remove_if([&drop](int x) { return x == 5 && (drop = !drop); }) == 15000u);
+        CHECK(container.count(5) == 15000u);
+        CHECK(container.remove_if([](int x) { return x == 8 || x == 12; }) == 2u);
+
+        container.remove(5);
+        CHECK(container.count(5) == 0u);
+        CHECK(container.size() == 9998u);
+        CHECK(*container.begin_ascending_order() == 0);
+        CHECK(*container.begin_descending_order() == 39996);
+        CHECK(container.try_remove(8) == 0u);
+    }
+
+    TEST_CASE("indexed strings on a memory resource")
+    {
+        CountingResource resource;
+        {
+            customContainer::pmr::MyContainer<std::string> words(&resource);
+            words.enable_index();
+            for (const char *word : {"pear", "apple", "pear", "fig"})
+                words.add(word);
+            CHECK(words.count("pear") == 2u);
+            words.remove("pear");
+            CHECK(container_to_string(words) == "[apple, fig, ]");
+            CHECK(*words.begin_ascending_order() == "apple");
+        }
+        CHECK(resource.live == 0u);
+    }
+}
+
+TEST_SUITE("batch removal")
+{
+    TEST_CASE_TEMPLATE("remove_if() and remove_all() in one pass", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>, MyContainer<int, LinkedStorage, PoolAllocator<int>>)
+    {
+        Container container{4, 9, 2, 7, 4, 6, 1, 8};
+        CHECK(*container.begin_ascending_order() == 1);
+
+        CHECK(container.remove_if([](int x) { return x % 2 == 0; }) == 5u);
+        CHECK(container_to_string(container) == "[9, 7, 1, ]");
+        CHECK(*container.begin_ascending_order() == 1);
+        CHECK(container.remove_if([](int x) { return x > 100; }) == 0u);
+
+        const std::vector<int> more{3, 9, 5};
+        container.add_range(more.begin(), more.end());
+        const std::vector<int> unwanted{9, 5, 42, 9};
+        CHECK(container.remove_all(unwanted) == 3u);
+        CHECK(container_to_string(container) == "[7, 1, 3, ]");
+        CHECK(*container.begin_descending_order() == 7);
+
+        CHECK(container.remove_all({42, 43}) == 0u);
+        CHECK(container.remove_all({1, 3, 7}) == 3u);
+        CHECK(container.size() == 0u);
+        CHECK(container.remove_all({1}) == 0u);
+    }
+
+    TEST_CASE_TEMPLATE("batch removal keeps the index in sync", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, UnrolledStorage>)
+    {
+        Container container{5, 3, 5, 1, 5, 2, 3};
+        container.enable_index();
+
+        CHECK(container.remove_if([](int x) { return x == 3; }) == 2u);
+        CHECK(container.count(3) == 0u);
+        CHECK(container.count(5) == 3u);
+
+        CHECK(container.remove_all({5, 2, 8}) == 4u);
+        CHECK(container.count(5) == 0u);
+        CHECK_FALSE(container.contains(2));
+        CHECK(container_to_string(container) == "[1, ]");
+
+        container.add(5);
+        CHECK(container.count(5) == 1u);
+        CHECK(container.remove_all(std::vector<int>{5}) == 1u);
+    }
+
+    TEST_CASE("remove_all() with values that can't be hashed")
+    {
+        struct Point
+        {
+            int x, y;
+            bool operator==(const Point &other) const { return x == other.x && y == other.y; }
+            bool operator<(const Point &other) const { return x < other.x || (x == other.x && y < other.y); }
+        };
+
+        MyContainer<Point> points{{1, 2}, {3, 4}, {1, 2}, {5, 6}};
+        CHECK(points.remove_all({Point{1, 2}, Point{7, 7}}) == 2u);
+        CHECK(points.size() == 2u);
+        CHECK(points.begin_ascending_order()->x == 3);
+    }
+}
+
+TEST_SUITE("non-throwing API")
+{
+    TEST_CASE_TEMPLATE("try_remove() and find()", Container,
+                       MyContainer<int, LinkedStorage>, MyContainer<int, ContiguousStorage>,
+                       MyContainer<int, UnrolledStorage>)
+    {
+        Container container;
+        CHECK(container.try_remove(1) == 0u);
+        CHECK(container.find(1) == container.end_order());
+
+        const int values[] = {4, 8, 4, 2};
+        container.add_range(std::begin(values), std::end(values));
+        CHECK(container.find(7) == container.end_order());
+        auto found = container.find(8);
+        REQUIRE(found != container.end_order());
+        CHECK(*found == 8);
+        CHECK(*++found == 4);
+
+        CHECK(container.try_remove(7) == 0u);
+        CHECK(container.try_remove(4) == 2u);
+        CHECK(container_to_string(container) == "[8, 2, ]");
+        CHECK(*container.begin_ascending_order() == 2);
+
+        container.enable_index();
+        CHECK(container.find(4) == container.end_order());
+        CHECK(*container.find(2) == 2);
+        CHECK(container.try_remove(2) == 1u);
+        CHECK(container.try_remove(2) == 0u);
+    }
+
+    // Refuses to be constructed from a negative value
+    struct Picky
+    {
+        int value;
+        explicit Picky(int value) : value(value)
+        {
+            if (value < 0)
+                throw std::invalid_argument("negative");
+        }
+        bool operator<(const Picky &other) const { return value < other.value; }
+        bool operator==(const Picky &other) const { return value == other.value; }
+    };
+
+    TEST_CASE_TEMPLATE("a failed construction gives its block back", Container,
+                       customContainer::pmr::MyContainer<Picky, LinkedStorage>,
+                       customContainer::pmr::MyContainer<Picky, UnrolledStorage>)
+    {
+        CountingResource resource;
+        {
+            Container container(&resource);
+            container.emplace(1);
+            CHECK_THROWS_AS(container.emplace(-1), std::invalid_argument);
+            container.reserve(40);
+            for (int x = 2; x < 40; ++x)
+                container.emplace(x);
+            CHECK_THROWS_AS(container.emplace(-2), std::invalid_argument);
+            CHECK(container.size() == 39u);
+            CHECK(container.begin_ascending_order()->value == 1);
+        }
+        CHECK(resource.live == 0u);
+    }
+}
+
+TEST_SUITE("sort paths")
+{
+    // Checks every sorted order of a container filled with values against std::sort
+    template<typename T>
+    void check_sorted_orders(const std::vector<T> &values)
+    {
+        MyContainer<T> container(values.begin(), values.end());
+        std::vector<T> expected(values);
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<T> asc, desc, cross;
+        for (const T &x : container.ascending())
+            asc.push_back(x);
+        for (const T &x : container.descending())
+            desc.push_back(x);
+        for (const T &x : container.side_cross())
+            cross.push_back(x);
+
+        std::vector<T> expectedCross;
+        for (std::size_t i = 0; i < expected.size(); ++i)
+            expectedCross.push_back(i % 2 == 0 ? expected[i / 2] : expected[expected.size() - 1 - i / 2]);
+
+        CHECK(asc == expected);
+        CHECK(std::equal(desc.begin(), desc.end(), expected.rbegin(), expected.rend()));
+        CHECK(cross == expectedCross);
+    }
+
+    TEST_CASE("radix sort of integers, floating point and characters")
+    {
+        std::mt19937 rng(7);
+        std::vector<int> ints(5000);
+        for (int &x : ints)
+            x = static_cast<int>(rng());
+        ints.push_back(std::numeric_limits<int>::min());
+        ints.push_back(std::numeric_limits<int>::max());
+        check_sorted_orders(ints);
+
+        std::vector<unsigned long long> wide(3000);
+        for (unsigned long long &x : wide)
+            x = (static_cast<unsigned long long>(rng()) << 32) | rng();
+        check_sorted_orders(wide);
+
+        std::vector<double> doubles(4000);
+        for (double &x : doubles)
+            x = std::ldexp(static_cast<double>(static_cast<int>(rng())), static_cast<int>(rng() % 80) - 40);
+        doubles.push_back(std::numeric_limits<double>::infinity());
+        doubles.push_back(-std::numeric_limits<double>::infinity());
+        doubles.push_back(0.0);
+        check_sorted_orders(doubles);
+
+        std::vector<float> floats(1000);
+        for (float &x : floats)
+            x = static_cast<float>(static_cast<int>(rng() % 2001) - 1000) / 8.0f;
+        check_sorted_orders(floats);
+
+        std::vector<char> chars(700);
+        for (char &c : chars)
+            c = static_cast<char>(rng());
+        check_sorted_orders(chars);
+
+        std::vector<short> shorts(100, 3);
+        check_sorted_orders(shorts);
+    }
+
+    TEST_CASE("counting sort of small-domain types")
+    {
+        std::mt19937 rng(11);
+        std::vector<unsigned char> bytes(3000);
+        for (unsigned char &b : bytes)
+            b = static_cast<unsigned char>(rng() % 7);
+        check_sorted_orders(bytes);
+
+        std::vector<short> shorts(20000);
+        for (short &x : shorts)
+            x = static_cast<short>(rng());
+        check_sorted_orders(shorts);
+
+        std::vector<unsigned short> few(5000);
+        for (unsigned short &x : few)
+            x = static_cast<unsigned short>(rng() % 3 == 0 ? 65535 : rng() % 50);
+        check_sorted_orders(few);
+    }
+
+    TEST_CASE("SIMD kernel matches std::sort")
+    {
+        std::mt19937 rng(13);
+        // Sizes around the 16-key blocks and the merge steps, and the container window
+        for (std::size_t n : {1, 3, 15, 16, 17, 33, 64, 100, 255, 256, 257, 700, 1023})
+        {
+            std::vector<int> ints(n);
+            for (int &x : ints)
+                x = static_cast<int>(rng() % 3 == 0 ? rng() % 5 : rng());
+            ints[0] = std::numeric_limits<int>::min();
+            std::vector<double> doubles(n);
+            for (double &x : doubles)
+                x = std::ldexp(static_cast<double>(static_cast<int>(rng())), static_cast<int>(rng() % 40) - 20);
+            doubles[n / 2] = -std::numeric_limits<double>::infinity();
+            std::vector<float> floats(n);
+            for (float &x : floats)
+                x = static_cast<float>(static_cast<int>(rng() % 201) - 100) / 4.0f;
+
+            check_sorted_orders(ints);
+            check_sorted_orders(doubles);
+            check_sorted_orders(floats);
+
+            if (!simd::available())
+                continue;
+            std::vector<int *> pointers;
+            for (int &x : ints)
+                pointers.push_back(&x);
+            simd_sort(pointers.data(), pointers.data() + n, std::allocator<int *>());
+            std::vector<int> sorted;
+            for (int *x : pointers)
+                sorted.push_back(*x);
+            std::sort(ints.begin(), ints.end());
+            CHECK(sorted == ints);
+
+            std::vector<double *> doublePointers;
+            for (double &x : doubles)
+                doublePointers.push_back(&x);
+            simd_sort(doublePointers.data(), doublePointers.data() + n, std::allocator<double *>());
+            CHECK(std::is_sorted(doublePointers.begin(), doublePointers.end(), [](double *a, double *b) { return *a < *b; }));
+            std::sort(doublePointers.begin(), doublePointers.end());
+            CHECK(std::adjacent_find(doublePointers.begin(), doublePointers.end()) == doublePointers.end());
+        }
+    }
+
+    TEST_CASE("SIMD kernel keeps every element of repeated 64-bit keys")
+    {
+        std::mt19937 rng(17);
+        for (std::size_t n : {16, 17, 64, 100, 255, 256, 700, 1023})
+        {
+            std::vector<double> doubles(n);
+            for (double &x : doubles)
+                x = static_cast<double>(rng() % 3) - 0.5;
+            std::vector<long> longs(n);
+            for (long &x : longs)
+                x = rng() % 2 == 0 ? std::numeric_limits<long>::max() : static_cast<long>(rng() % 4);
+            std::vector<unsigned long> maxima(n, std::numeric_limits<unsigned long>::max());
+            for (std::size_t i = 0; i < n; i += 3)
+                maxima[i] = rng() % 5;
+
+            check_sorted_orders(doubles);
+            check_sorted_orders(longs);
+            check_sorted_orders(maxima);
+
+            if (!simd::available())
+                continue;
+            std::vector<std::uint64_t> keys(n), positions(n);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                keys[i] = rng() % 3;
+                positions[i] = i;
+            }
+            simd::sort(keys.data(), positions.data(), n, std::allocator<std::uint64_t>());
+            CHECK(std::is_sorted(keys.begin(), keys.end()));
+            std::sort(positions.begin(), positions.end());
+            std::vector<std::uint64_t> all(n);
+            std::iota(all.begin(), all.end(), 0);
+            CHECK(positions == all);
+        }
+    }
+
+    TEST_CASE("string sort by prefix keys")
+    {
+        std::mt19937 rng(29);
+        std::vector<std::string> words;
+        for (int i = 0; i < 3000; ++i)
+        {
+            // Short words, long words sharing an 8-byte prefix, and bytes above 127
+            std::string word = i % 3 == 0 ? "prefix__" : "";
+            for (std::size_t length = rng() % 12; length > 0; --length)
+                word.push_back(static_cast<char>(i % 5 == 0 ? 'a' + rng() % 3 : rng() % 256));
+            words.push_back(word);
+        }
+        words.push_back("");
+        words.push_back(std::string("ab\0", 3));
+        words.push_back("ab");
+        words.push_back(std::string("ab\0\0\0\0\0\0\0c", 10));
+        // Enough strings with a 20-byte shared prefix to be radix sorted 3 levels deep
+        for (int i = 0; i < 300; ++i)
+            words.push_back(std::string(20, 'x') + std::to_string(rng() % 50) + std::string(i % 3, '\0'));
+        check_sorted_orders(words);
+
+        // Through a projection that returns the string by reference
+        struct Named
+        {
+            std::string name;
+        };
+        auto byName = [](const Named &named) -> const std::string & { return named.name; };
+        MyContainer<Named, LinkedStorage, std::allocator<Named>, std::less<>, decltype(byName)> named(std::less<>(), byName);
+        for (const std::string &word : words)
+            named.add({word});
+        std::vector<std::string> sorted;
+        for (const Named &n : named.ascending())
+            sorted.push_back(n.name);
+        std::sort(words.begin(), words.end());
+        CHECK(sorted == words);
+    }
+
+    TEST_CASE("value sort of trivially copyable types without a radix key")
+    {
+        struct Pair
+        {
+            int key;
+            int tag;
+            bool operator<(const Pair &other) const { return key < other.key; }
+        };
+        std::mt19937 rng(19);
+        std::vector<Pair> pairs(500);
+        for (std::size_t i = 0; i < pairs.size(); ++i)
+            pairs[i] = Pair{static_cast<int>(rng() % 40), static_cast<int>(i)};
+        std::vector<Pair *> pointers;
+        for (Pair &pair : pairs)
+            pointers.push_back(&pair);
+        value_sort(pointers.data(), pointers.data() + pointers.size(), std::allocator<Pair *>());
+        CHECK(std::is_sorted(pointers.begin(), pointers.end(), [](Pair *a, Pair *b) { return *a < *b; }));
+        std::sort(pointers.begin(), pointers.end());
+        CHECK(std::adjacent_find(pointers.begin(), pointers.end()) == pointers.end());
+
+        // Large enough for the container to take the value sort
+        std::vector<long double> wide(ValueSortMinimum + 3);
+        for (long double &x : wide)
+            x = static_cast<long double>(static_cast<int>(rng() % 100000)) / 7;
+        check_sorted_orders(wide);
+    }
+
+    // Counts the comparisons made through it
+    struct CountingLess
+    {
+        std::size_t *calls;
+
+        bool operator()(int a, int b) const
+        {
+            ++*calls;
+            return a < b;
+        }
+    };
+
+    TEST_CASE("lazy sort reads the top elements in about one pass")
+    {
+        const std::size_t n = 100000;
+        std::mt19937 rng(31);
+        std::vector<int> random(n), equal(n, 7), ascending(n), few(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            random[i] = static_cast<int>(rng());
+            ascending[i] = static_cast<int>(i);
+            few[i] = static_cast<int>(rng() % 3);
+        }
+
+        for (const std::vector<int> *values : {&random, &equal, &ascending, &few})
+        {
+            std::vector<int> expected(*values);
+            std::sort(expected.begin(), expected.end());
+
+            std::size_t calls = 0;
+            MyContainer<int, LinkedStorage, std::allocator<int>, CountingLess> container(CountingLess{&calls});
+            container.add_range(values->begin(), values->end());
+
+            // The 10 smallest and the 10 largest, without sorting the rest
+            auto smallest = container.begin_ascending_order();
+            auto largest = container.begin_descending_order();
+            for (std::size_t i = 0; i < 10; ++i, ++smallest, ++largest)
+            {
+                CHECK(*smallest == expected[i]);
+                CHECK(*largest == expected[n - 1 - i]);
+            }
+            CHECK(calls < 6 * n);
+
+            // Reading on settles the rest, in the same order
+            std::vector<int> all;
+            for (int x : container.ascending())
+                all.push_back(x);
+            CHECK(all == expected);
+        }
+    }
+
+    TEST_CASE("lazy side-cross reads both ends without a full sort")
+    {
+        const std::size_t n = 100000;
+        std::mt19937 rng(37);
+        std::vector<int> values(n);
+        for (int &x : values)
+            x = static_cast<int>(rng() % 50000);
+        std::vector<int> expected(values);
+        std::sort(expected.begin(), expected.end());
+
+        std::size_t calls = 0;
+        MyContainer<int, UnrolledStorage, std::allocator<int>, CountingLess> container(CountingLess{&calls});
+        container.add_range(values.begin(), values.end());
+        auto it = container.begin_side_cross_order();
+        for (std::size_t i = 0; i < 20; ++i, ++it)
+            CHECK(*it == (i % 2 == 0 ? expected[i / 2] : expected[n - 1 - i / 2]));
+        CHECK(calls < 6 * n);
+
+        std::vector<int> cross;
+        for (int x : container.side_cross())
+            cross.push_back(x);
+        REQUIRE(cross.size() == n);
+        CHECK(cross[n - 1] == expected[n / 2]);
+        CHECK(cross[n - 2] == expected[n / 2 - 1 + n % 2]);
+    }
+
+    TEST_CASE("copies of one lazy iterator can be read from several threads")
+    {
+        const std::size_t n = 100000;
+        std::mt19937 rng(41);
+        std::vector<int> values(n);
+        for (int &x : values)
+            x = static_cast<int>(rng());
+        std::vector<int> expected(values);
+        std::sort(expected.begin(), expected.end());
+
+        MyContainer<int> container(values.begin(), values.end());
+        const auto ascending = container.begin_ascending_order();
+        const auto cross = container.begin_side_cross_order();
+        std::vector<int> mismatches(4, 0);
+        std::vector<std::thread> readers;
+        for (std::size_t t = 0; t < mismatches.size(); ++t)
+        {
+            readers.emplace_back([&, t] {
+                // Each reader starts somewhere else, so they settle different segments at once
+                for (std::size_t i = 0; i < n; i += 97)
+                {
+                    const std::size_t at = (i + t * n / 4) % n;
+                    mismatches[t] += ascending[static_cast<std::ptrdiff_t>(at)] != expected[at];
+                    const std::size_t step = at % 2 == 0 ? at / 2 : n - 1 - at / 2;
+                    mismatches[t] += cross[static_cast<std::ptrdiff_t>(at)] != expected[step];
+                }
+            });
+        }
+        for (std::thread &reader : readers)
+            reader.join();
+        CHECK(mismatches == std::vector<int>(4, 0));
+    }
+
+    TEST_CASE("parallel sort matches the single-threaded sort")
+    {
+        std::mt19937 rng(17);
+        std::vector<int> ints(20011);
+        for (int &x : ints)
+            x = static_cast<int>(rng() % 5000);
+        std::vector<std::string> words(3001);
+        for (std::string &word : words)
+            word = std::to_string(rng() % 1000);
+
+        for (unsigned threads : {1u, 2u, 3u, 4u, 7u})
+        {
+            MyContainer<int> numbers(ints.begin(), ints.end());
+            numbers.set_sort_options({1000, threads});
+            CHECK(numbers.sort_options().threads == threads);
+            std::vector<int> sorted;
+            for (int x : numbers.ascending())
+                sorted.push_back(x);
+            std::vector<int> expected(ints);
+            std::sort(expected.begin(), expected.end());
+            CHECK(sorted == expected);
+
+            // Slices that fall back to std::sort, and an allocator that isn't thread safe
+            MyContainer<std::string, LinkedStorage, PoolAllocator<std::string>> text(words.begin(), words.end());
+            text.set_sort_options({0, threads});
+            std::vector<std::string> sortedWords;
+            for (const std::string &word : text.ascending())
+                sortedWords.push_back(word);
+            std::vector<std::string> expectedWords(words);
+            std::sort(expectedWords.begin(), expectedWords.end());
+            CHECK(sortedWords == expectedWords);
+        }
+
+        // The options travel with copies
+        MyContainer<int> small{3, 1, 2};
+        small.set_sort_options({0, 2});
+        MyContainer<int> copy(small);
+        CHECK(copy.sort_options().threads == 2);
+        CHECK(*copy.begin_ascending_order() == 1);
+    }
+
+    TEST_CASE("thread pool runs every task once and reports errors")
+    {
+        ThreadPool pool;
+        std::vector<int> hits(100, 0);
+        pool.run(hits.size(), 4, [&](std::size_t i) { ++hits[i]; });
+        CHECK(std::count(hits.begin(), hits.end(), 1) == 100);
+        CHECK(pool.size() == 3);
+
+        CHECK_THROWS_AS(pool.run(10, 3, [](std::size_t i) {
+            if (i == 5)
+                throw std::runtime_error("task failed");
+        }), std::runtime_error);
+        pool.run(0, 4, [](std::size_t) {});
+    }
+}
+
+TEST_SUITE("comparator and projection")
+{
+    struct Person
+    {
+        std::string name;
+        int age;
+    };
+
+    // A projection that computes its key and counts how often it is called
+    struct LowercaseName
+    {
+        std::size_t *calls;
+
+        std::string operator()(const Person &person) const
+        {
+            ++*calls;
+            std::string key(person.name);
+            for (char &c : key)
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            return key;
+        }
+    };
+
+    template<typename Container>
+    std::vector<std::string> names(Container &container)
+    {
+        std::vector<std::string> result;
+        for (const Person &person : container.ascending())
+            result.push_back(person.name);
+        return result;
+    }
+
+    TEST_CASE("sorting structs by one field")
+    {
+        auto byAge = [](const Person &person) { return person.age; };
+        MyContainer<Person, LinkedStorage, std::allocator<Person>, std::less<>, decltype(byAge)> people(std::less<>(), byAge);
+        people.add({"carol", 41});
+        people.add({"alice", 30});
+        people.add({"bob", 35});
+        CHECK(names(people) == std::vector<std::string>{"alice", "bob", "carol"});
+
+        std::vector<std::string> descending;
+        for (const Person &person : people.descending())
+            descending.push_back(person.name);
+        CHECK(descending == std::vector<std::string>{"carol", "bob", "alice"});
+
+        std::vector<int> cross;
+        for (const Person &person : people.side_cross())
+            cross.push_back(person.age);
+        CHECK(cross == std::vector<int>{30, 41, 35});
+
+        // Enough elements for the radix sort on the projected keys, on one and on 3 threads
+        std::mt19937 rng(23);
+        for (int i = 0; i < 500; ++i)
+            people.add({std::to_string(i), static_cast<int>(rng() % 200) - 100});
+        for (unsigned threads : {1u, 3u})
+        {
+            people.set_sort_options({0, threads});
+            MyContainer<Person, LinkedStorage, std::allocator<Person>, std::less<>, decltype(byAge)> copy(people);
+            std::vector<int> ages;
+            for (const Person &person : copy.ascending())
+                ages.push_back(person.age);
+            CHECK(ages.size() == 503u);
+            CHECK(std::is_sorted(ages.begin(), ages.end()));
+        }
+    }
+
+    // A comparator with state, ascending or descending
+    struct Direction
+    {
+        bool descending;
+
+        bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+    };
+
+    TEST_CASE("assignment takes over the order of the other container")
+    {
+        using Container = MyContainer<int, LinkedStorage, std::allocator<int>, Direction>;
+        Container up(Direction{false});
+        Container down(Direction{true});
+        for (int x : {2, 3, 1})
+        {
+            up.add(x);
+            down.add(x);
+        }
+        CHECK(*up.begin_ascending_order() == 1);
+
+        up = down;
+        CHECK(*up.begin_ascending_order() == 3);
+        Container back(Direction{false});
+        back = std::move(up);
+        CHECK(*back.begin_ascending_order() == 3);
+
+        // A lambda without captures can't be assigned, but orders the same way in every container
+        auto byAge = [](const Person &person) { return person.age; };
+        using People = MyContainer<Person, LinkedStorage, std::allocator<Person>, std::less<>, decltype(byAge)>;
+        People people(std::less<>(), byAge);
+        people.add({"carol", 41});
+        people.add({"alice", 30});
+        People copy(std::less<>(), byAge);
+        copy = people;
+        CHECK(names(copy) == std::vector<std::string>{"alice", "carol"});
+        copy = std::move(people);
+        CHECK(names(copy) == std::vector<std::string>{"alice", "carol"});
+    }
+
+    TEST_CASE("std::greater turns the ascending order around")
+    {
+        for (int n : {5, 300})
+        {
+            MyContainer<int, LinkedStorage, std::allocator<int>, std::greater<>> container;
+            for (int i = 0; i < n; ++i)
+                container.add((i * 37) % n - n / 2);
+            std::vector<int> values;
+            for (int x : container.ascending())
+                values.push_back(x);
+            CHECK(values.size() == static_cast<std::size_t>(n));
+            CHECK(std::is_sorted(values.rbegin(), values.rend()));
+            CHECK(*container.begin_descending_order() == -n / 2);
+        }
+    }
+
+    TEST_CASE("computed keys are computed once per element")
+    {
+        std::size_t calls = 0;
+        MyContainer<Person, UnrolledStorage, std::allocator<Person>, std::less<>, LowercaseName> people(
+            std::less<>(), LowercaseName{&calls});
+        const char *raw[] = {"delta", "Alpha", "charlie", "Echo", "bravo", "Foxtrot", "golf", "Hotel"};
+        for (const char *name : raw)
+            people.add({name, 0});
+        CHECK(names(people) == std::vector<std::string>{"Alpha", "bravo", "charlie", "delta", "Echo", "Foxtrot", "golf", "Hotel"});
+        CHECK(calls == 8u);
+
+        // Sorted orders share the cached sort, so the keys are not computed again
+        names(people);
+        CHECK(calls == 8u);
+    }
+
+    TEST_CASE("the lazy sort computes each key once too")
+    {
+        std::size_t calls = 0;
+        std::size_t uncounted = 0;
+        const LowercaseName lowercase{&uncounted};
+        MyContainer<Person, LinkedStorage, std::allocator<Person>, std::less<>, LowercaseName> people(
+            std::less<>(), LowercaseName{&calls});
+        std::mt19937 rng(41);
+        std::vector<std::string> expected;
+        for (int i = 0; i < 20000; ++i)
+        {
+            std::string name;
+            for (int length = 0; length < 6; ++length)
+                name.push_back(static_cast<char>((rng() % 2 == 0 ? 'a' : 'A') + rng() % 26));
+            people.add({name, i});
+            expected.push_back(lowercase({name, i}));
+        }
+        std::sort(expected.begin(), expected.end());
+
+        // Reading the first element decorates every element once and sorts only a little
+        CHECK(lowercase(*people.begin_ascending_order()) == expected.front());
+        CHECK(calls == expected.size());
+
+        std::vector<std::string> keys;
+        for (const Person &person : people.ascending())
+            keys.push_back(lowercase(person));
+        CHECK(keys == expected);
+        CHECK(calls == expected.size());
+    }
+}
+
 TEST_SUITE("operator chaining and incremental operators")
 {
     TEST_CASE("post-increment and pre-increment consistency")
@@ -221,6 +1863,34 @@ TEST_SUITE("operator chaining and incremental operators")
         ++itD;
         CHECK(*itD == 10);
     }
+
+    TEST_CASE("copied iterators advance independently")
+    {
+        MyContainer<int> container;
+        container.add(2);
+        container.add(3);
+        container.add(1);
+
+        // The copies share the ordering but keep their own position
+        auto itS = container.begin_side_cross_order();
+        auto itS_post = itS++;
+        CHECK(*itS_post == 1);
+        CHECK(*itS == 3);
+
+        auto itR = container.begin_reverse_order();
+        auto itR_copy = itR;
+        ++itR;
+        CHECK(*itR_copy == 1);
+        CHECK(*itR == 3);
+
+        auto itM = container.begin_middle_out_order();
+        auto itM_post = itM++;
+        CHECK(*itM_post == 3);
+        CHECK(*itM == 2);
+        ++itM;
+        CHECK(*itM == 1);
+        CHECK(*itM_post == 3);
+    }
 }
 
 
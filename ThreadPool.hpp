@@ -0,0 +1,171 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace customContainer
+    {
+    /**
+     * A small pool of worker threads for the parallel sort. The workers are started on
+     * first use and kept until the pool is destroyed, so a sort doesn't pay for creating
+     * threads. Work is handed out with run(), which splits a loop of tasks between the
+     * calling thread and the workers and returns once every task is done.
+     */
+    class ThreadPool
+    {
+    private:
+        /// One run() call. Shared with the helper jobs, which may still be queued when
+        /// the call returns and then find no task left to take.
+        struct Batch
+        {
+            std::function<void(std::size_t)> task;
+            std::size_t count;
+            std::atomic<std::size_t> next{0};
+            std::size_t finished = 0;
+            std::mutex mutex;
+            std::condition_variable done;
+            std::exception_ptr error;
+
+            /// Takes and runs tasks until there are none left
+            void work()
+            {
+                for (std::size_t i = next++; i < count; i = next++)
+                {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+                    try
+                    {
+                        task(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+#else
+                    task(i);
+#endif
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (++finished == count)
+                        done.notify_all();
+                }
+            }
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::shared_ptr<Batch>> jobs;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+
+        void worker_loop()
+        {
+            for (;;)
+            {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (jobs.empty())
+                        return;
+                    batch = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                batch->work();
+            }
+        }
+
+    public:
+        ThreadPool() = default;
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * Lets the workers finish the queued jobs and joins them.
+         */
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread &worker : workers)
+                worker.join();
+        }
+
+        /**
+         * @return the number of threads the hardware runs at once, at least 1
+         */
+        static unsigned hardware_threads()
+        {
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /**
+         * The pool used by the parallel sort of every container.
+         */
+        static ThreadPool &shared()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        /**
+         * @return how many worker threads have been started
+         */
+        std::size_t size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return workers.size();
+        }
+
+        /**
+         * Calls task(i) for every i in [0, count) on up to threads threads, the calling
+         * thread being one of them, and returns when all the calls have returned. Workers
+         * are started as needed. The first exception thrown by a task is rethrown here.
+         * Tasks must not call run() themselves.
+         * @param count - the number of tasks
+         * @param threads - the most threads to use, including the caller
+         * @param task - called with each task number
+         */
+        template<typename Task>
+        void run(std::size_t count, unsigned threads, Task task)
+        {
+            if (count == 0)
+                return;
+
+            auto batch = std::make_shared<Batch>();
+            batch->task = std::ref(task);
+            batch->count = count;
+            const std::size_t helpers = std::min<std::size_t>(count, std::max(1u, threads)) - 1;
+            if (helpers > 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    while (workers.size() < helpers)
+                        workers.emplace_back([this] { worker_loop(); });
+                    for (std::size_t i = 0; i < helpers; ++i)
+                        jobs.push_back(batch);
+                }
+                wake.notify_all();
+            }
+
+            batch->work();
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->done.wait(lock, [&] { return batch->finished == count; });
+            if (batch->error)
+                std::rethrow_exception(batch->error);
+        }
+    };
+}
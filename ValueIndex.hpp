@@ -0,0 +1,246 @@
+// shaked1mi@gmail.com
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace customContainer
+    {
+    /**
+     * True when std::hash<T> is usable, i.e. T can be a key of the value index.
+     */
+    template<typename T, typename = void>
+    struct is_hashable : std::false_type
+    {
+    };
+
+    template<typename T>
+    struct is_hashable<T, std::void_t<decltype(std::hash<T>()(std::declval<const T &>()))>> : std::true_type
+    {
+    };
+
+    /**
+     * A hash index from each distinct value to how many elements hold it. When the storage
+     * keeps its cursors valid (LinkedStorage) the index also remembers where every element
+     * is, so all elements of a value can be removed without walking the storage.
+     * The index is kept in sync by the container, it never changes the storage itself.
+     * @tparam T - the element type
+     * @tparam Elements - the storage type of the container
+     * @tparam Allocator - the container's allocator, rebound for the index tables
+     */
+    template<typename T, typename Elements, typename Allocator, bool Hashable = is_hashable<T>::value>
+    class ValueIndex
+    {
+    private:
+        using Cursor = typename Elements::Cursor;
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using CursorAllocator = typename AllocatorTraits::template rebind_alloc<Cursor>;
+
+    public:
+        static constexpr bool TracksPositions = Elements::stable_cursors;
+
+        using Positions = std::vector<Cursor, CursorAllocator>;
+
+    private:
+        /// What is kept per value when the positions are tracked
+        struct PositionedEntry
+        {
+            std::size_t count;
+            Positions positions;
+            bool stale; /// Some positions are gone, see refresh()
+
+            explicit PositionedEntry(const CursorAllocator &allocator) : count(0), positions(allocator), stale(false)
+            {
+            }
+        };
+
+        /// ... and when only the elements are counted, which saves a vector per value
+        struct CountedEntry
+        {
+            std::size_t count;
+
+            explicit CountedEntry(const CursorAllocator &) : count(0)
+            {
+            }
+        };
+
+        using Entry = std::conditional_t<TracksPositions, PositionedEntry, CountedEntry>;
+
+        using EntryAllocator = typename AllocatorTraits::template rebind_alloc<std::pair<const T, Entry>>;
+
+        CursorAllocator cursorAllocator;
+        std::unordered_map<T, Entry, std::hash<T>, std::equal_to<T>, EntryAllocator> entries;
+        std::size_t staleEntries = 0; /// Entries whose positions refresh() has to rebuild
+
+    public:
+        /**
+         * Indexes every element the storage holds.
+         * @param storage - the storage of the container
+         * @param allocator - the container's allocator
+         */
+        ValueIndex(Elements &storage, const Allocator &allocator)
+            : cursorAllocator(allocator), entries(0, std::hash<T>(), std::equal_to<T>(), EntryAllocator(allocator))
+        {
+            entries.reserve(storage.size());
+            for (Cursor pos = storage.begin(); pos != storage.end(); ++pos)
+                added(*pos, pos);
+        }
+
+        /**
+         * Records an element that was just added.
+         * @param value - the element
+         * @param position - where the element is in the storage
+         */
+        void added(const T &value, Cursor position)
+        {
+            Entry &entry = entries.try_emplace(value, cursorAllocator).first->second;
+            ++entry.count;
+            if constexpr (TracksPositions)
+                entry.positions.push_back(position);
+        }
+
+        /**
+         * Forgets one element that is about to be removed on its own (e.g. by a predicate).
+         * Finding its position among those of equal elements would cost a scan per removal,
+         * so the value's positions are only marked stale here; once the batch is erased
+         * refresh() rebuilds them in one pass. A value with no element left is dropped
+         * outright and needs no refresh.
+         * @param element - the element itself, not only an equal value
+         */
+        void removed(const T &element)
+        {
+            auto it = entries.find(element);
+            if (it == entries.end())
+                return;
+
+            Entry &entry = it->second;
+            if constexpr (TracksPositions)
+            {
+                if (--entry.count == 0)
+                {
+                    staleEntries -= entry.stale ? 1 : 0;
+                    entries.erase(it);
+                }
+                else if (!entry.stale)
+                {
+                    entry.stale = true;
+                    ++staleEntries;
+                }
+            }
+            else if (--entry.count == 0)
+            {
+                entries.erase(it);
+            }
+        }
+
+        /**
+         * Rebuilds the positions marked stale by removed(), after the removed elements are
+         * gone from the storage. Stale positions are dropped unread, and one walk over the
+         * storage collects the positions of the values that still have elements.
+         * @param storage - the storage of the container
+         */
+        void refresh(Elements &storage)
+        {
+            if constexpr (TracksPositions)
+            {
+                if (staleEntries == 0)
+                    return;
+
+                for (auto &item : entries)
+                    if (item.second.stale)
+                        item.second.positions.clear();
+                for (Cursor pos = storage.begin(); pos != storage.end(); ++pos)
+                {
+                    auto it = entries.find(*pos);
+                    if (it != entries.end() && it->second.stale)
+                        it->second.positions.push_back(pos);
+                }
+                for (auto &item : entries)
+                    item.second.stale = false;
+                staleEntries = 0;
+            }
+        }
+
+        /**
+         * Forgets every element equal to value.
+         * @return where those elements are (empty unless TracksPositions)
+         */
+        Positions take(const T &value)
+        {
+            auto it = entries.find(value);
+            if (it == entries.end())
+                return Positions(cursorAllocator);
+
+            Positions positions(cursorAllocator);
+            if constexpr (TracksPositions)
+                positions = std::move(it->second.positions);
+            entries.erase(it);
+            return positions;
+        }
+
+        /**
+         * @return how many elements are equal to value
+         */
+        std::size_t count(const T &value) const
+        {
+            auto it = entries.find(value);
+            return it == entries.end() ? 0 : it->second.count;
+        }
+
+        /**
+         * Forgets every element.
+         */
+        void clear()
+        {
+            entries.clear();
+            staleEntries = 0;
+        }
+    };
+
+    /**
+     * Elements that can't be hashed can't be indexed, MyContainer::enable_index() refuses them.
+     */
+    template<typename T, typename Elements, typename Allocator>
+    class ValueIndex<T, Elements, Allocator, false>
+    {
+    public:
+        static constexpr bool TracksPositions = false;
+
+        using Positions = std::vector<typename Elements::Cursor>;
+
+        ValueIndex(Elements &, const Allocator &)
+        {
+        }
+
+        void added(const T &, typename Elements::Cursor)
+        {
+        }
+
+        void removed(const T &)
+        {
+        }
+
+        void refresh(Elements &)
+        {
+        }
+
+        Positions take(const T &)
+        {
+            return Positions();
+        }
+
+        std::size_t count(const T &) const
+        {
+            return 0;
+        }
+
+        void clear()
+        {
+        }
+    };
+}